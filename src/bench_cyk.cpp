@@ -0,0 +1,82 @@
+// Benchmark: cell-by-cell CYK (CYKParser) against the matrix
+// multiplication fill (ValiantParser) on a CNF grammar.
+//
+// Usage: CYKBench [grammar.json] [pattern] [length...]
+// The input of each length repeats `pattern` (not empty); lengths are
+// decimal numbers. Defaults to S -> SS | a on a^256 .. a^2048.
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "logic/CYKParser.h"
+#include "logic/ValiantParser.h"
+
+template <typename Parser>
+static double timeParse(Parser &parser, const std::string &input, bool &accepted) {
+  auto start = std::chrono::steady_clock::now();
+  accepted = parser.parse(input);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void usage(const char *program) {
+  std::cerr << "usage: " << program << " [grammar.json] [pattern] [length...]" << std::endl;
+}
+
+// A whole non-negative decimal number, false for "", "abc", "-1", "4k"
+static bool parseCount(const std::string &text, size_t &out) {
+  if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+  try {
+    out = std::stoul(text);
+  } catch (const std::out_of_range &) {
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::string grammarFile = argc > 1 ? argv[1] : "../src/JSON/input-cnf-ambiguous.json";
+  std::string pattern = argc > 2 ? argv[2] : "a";
+  if (pattern.empty()) {
+    std::cerr << "the pattern must not be empty" << std::endl;
+    usage(argv[0]);
+    return 2;
+  }
+  std::vector<size_t> lengths;
+  for (int i = 3; i < argc; i++) {
+    size_t n = 0;
+    if (!parseCount(argv[i], n)) {
+      std::cerr << "invalid length: " << argv[i] << std::endl;
+      usage(argv[0]);
+      return 2;
+    }
+    lengths.push_back(n);
+  }
+  if (lengths.empty()) lengths = {256, 512, 1024, 2048};
+
+  try {
+    CFG cfg(grammarFile);
+    CYKParser cyk(cfg);
+    ValiantParser valiant(cfg);
+
+    std::cout << "length\tCYK ms\tValiant ms\taccepted\n";
+    for (size_t n : lengths) {
+      std::string input;
+      while (input.size() < n) input += pattern;
+      input.resize(n);
+
+      bool cykResult = false, valiantResult = false;
+      double cykMs = timeParse(cyk, input, cykResult);
+      double valiantMs = timeParse(valiant, input, valiantResult);
+      std::cout << n << "\t" << cykMs << "\t" << valiantMs << "\t" << cykResult;
+      if (cykResult != valiantResult) std::cout << "\t(MISMATCH)";
+      std::cout << "\n";
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include "BatchRunner.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+BatchRunner::BatchRunner(std::shared_ptr<const CompiledGrammar> grammar, ParseEngine engine, ThreadPool &pool)
+    : grammar(std::move(grammar)), engine(engine), pool(pool), sessions(pool.size() + 1) {}
+
+/**************************************************
+ * Input
+ **************************************************/
+
+bool BatchRunner::readInput(std::istream &in, InputFraming framing, std::string &input) {
+  if (framing == InputFraming::Lines) {
+    if (!std::getline(in, input)) return false;
+    if (!input.empty() && input.back() == '\r') input.pop_back();
+    return true;
+  }
+
+  // "<length>\n<bytes>", whitespace between records is skipped
+  in >> std::ws;
+  if (in.peek() == std::char_traits<char>::eof()) return false;
+  size_t length = 0;
+  if (!(in >> length) || in.get() != '\n') {
+    throw std::runtime_error("batch input: expected \"<length>\\n\" before a record");
+  }
+  // The length is not trusted with an allocation: the record grows a
+  // chunk at a time, so a huge prefix on a short stream is only truncated
+  constexpr size_t Chunk = size_t(1) << 16;
+  input.clear();
+  while (input.size() < length) {
+    size_t have = input.size(), want = std::min(Chunk, length - have);
+    input.resize(have + want);
+    in.read(&input[have], (std::streamsize)want);
+    if ((size_t)in.gcount() != want) {
+      throw std::runtime_error("batch input: record of " + std::to_string(length) + " bytes is truncated");
+    }
+  }
+  return true;
+}
+
+/**************************************************
+ * Parsing
+ **************************************************/
+
+BatchSummary BatchRunner::run(std::istream &in, InputFraming framing, std::ostream &out) {
+  auto start = std::chrono::steady_clock::now();
+  BatchSummary summary;
+  std::vector<std::string> block;
+  std::vector<Result> results;
+  std::string lines;
+  bool more = true;
+  while (more) {
+    block.clear();
+    std::string input;
+    while (block.size() < blockSize && (more = readInput(in, framing, input))) {
+      block.push_back(std::move(input));
+    }
+    if (block.empty()) break;
+
+    results.assign(block.size(), Result());
+    size_t grain = std::max<size_t>(1, block.size() / (8 * (pool.size() + 1)));
+    pool.parallelFor(block.size(), [&](size_t i, size_t worker) {
+      parseOne(block[i], worker, results[i]);
+    }, grain);
+
+    lines.clear();
+    for (size_t i = 0; i < block.size(); i++) {
+      appendLine(lines, summary.inputs + i, block[i].size(), results[i]);
+      summary.accepted += results[i].accepted;
+      summary.errors += results[i].failed;
+    }
+    summary.inputs += block.size();
+    out << lines;
+    out.flush();
+  }
+  summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return summary;
+}
+
+void BatchRunner::parseOne(const std::string &input, size_t worker, Result &result) {
+  try {
+    // Making the session is not part of the first input's time
+    std::unique_ptr<ParseSession> &session = sessions[worker];
+    if (!session) session.reset(new ParseSession(grammar, engine));
+
+    auto start = std::chrono::steady_clock::now();
+    result.accepted = session->parse(input);
+    result.micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    result.counters = session->counters();
+  } catch (const std::exception &e) {
+    result.accepted = false;
+    result.failed = true;
+    result.error = e.what();
+  }
+}
+
+/**************************************************
+ * Output
+ **************************************************/
+
+void BatchRunner::appendLine(std::string &out, size_t index, size_t length, const Result &result) const {
+  char micros[32];
+  std::snprintf(micros, sizeof(micros), "%.2f", result.micros);
+  out += "{\"index\":" + std::to_string(index) + ",\"length\":" + std::to_string(length);
+  if (result.failed) {
+    out += ",\"error\":" + json(result.error).dump();
+  } else {
+    out += result.accepted ? ",\"accepted\":true" : ",\"accepted\":false";
+  }
+  out += ",\"micros\":";
+  out += micros;
+  if (engine == ParseEngine::Earley) {
+    out += ",\"items\":" + std::to_string(result.counters.items);
+  } else {
+    out += ",\"shifts\":" + std::to_string(result.counters.shifts) +
+           ",\"reductions\":" + std::to_string(result.counters.reductions) +
+           ",\"gssNodes\":" + std::to_string(result.counters.gssNodes) +
+           ",\"gssEdges\":" + std::to_string(result.counters.gssEdges);
+  }
+  out += "}\n";
+}
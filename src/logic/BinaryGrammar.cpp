@@ -0,0 +1,157 @@
+#include "BinaryGrammar.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t ByteOrderMark = 0x01020304;
+
+size_t aligned(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+} // namespace
+
+/**************************************************
+ * Reading
+ **************************************************/
+
+bool BinaryGrammar::isBinaryGrammarFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[4] = {};
+  return in.read(magic, 4) && std::memcmp(magic, "CFGB", 4) == 0;
+}
+
+std::shared_ptr<const BinaryGrammar> BinaryGrammar::open(const std::string &path) {
+  auto file = std::make_shared<MappedFile>(path);
+  auto fail = [&](const std::string &why) {
+    return std::runtime_error("Binary grammar " + path + ": " + why);
+  };
+  if (file->size() == 0) throw std::runtime_error("Unable to open file " + path);
+  if (file->size() < sizeof(Header) || std::memcmp(file->data(), "CFGB", 4) != 0) {
+    throw fail("not a .cfgb file");
+  }
+
+  const Header *header = reinterpret_cast<const Header *>(file->data());
+  if (header->version != FormatVersion) throw fail("format version " + std::to_string(header->version));
+  if (header->byteOrder != ByteOrderMark) throw fail("written with another byte order");
+
+  // Section sizes must add up to the file size exactly. Every count is
+  // bounded by the file size first, so the sums below cannot overflow.
+  size_t size = file->size();
+  if (header->symbolCount >= size || header->productionCount >= size ||
+      header->bodySymbolCount >= size || header->nameBytes >= size) {
+    throw fail("truncated");
+  }
+  size_t symbols = header->symbolCount, productions = header->productionCount;
+  size_t offsetBytes = aligned((symbols + 1) * sizeof(uint32_t));
+  size_t nameBytes = aligned(header->nameBytes);
+  size_t flagBytes = aligned(symbols);
+  size_t headBytes = aligned(productions * sizeof(uint32_t));
+  size_t bodyOffsetBytes = aligned((productions + 1) * sizeof(uint32_t));
+  size_t bodyBytes = aligned(header->bodySymbolCount * sizeof(uint32_t));
+  if (size != sizeof(Header) + offsetBytes + nameBytes + flagBytes + headBytes + bodyOffsetBytes + bodyBytes) {
+    throw fail("section sizes do not match the file size");
+  }
+
+  std::shared_ptr<BinaryGrammar> g(new BinaryGrammar());
+  const char *at = file->data() + sizeof(Header);
+  g->header = header;
+  g->nameOffsets = reinterpret_cast<const uint32_t *>(at);
+  g->names = at += offsetBytes;
+  g->symbolFlags = reinterpret_cast<const uint8_t *>(at += nameBytes);
+  g->heads = reinterpret_cast<const uint32_t *>(at += flagBytes);
+  g->bodyOffsets = reinterpret_cast<const uint32_t *>(at += headBytes);
+  g->bodySymbols = reinterpret_cast<const uint32_t *>(at += bodyOffsetBytes);
+  g->storage = std::move(file);
+
+  // One pass over the arrays, so the accessors never read out of bounds
+  if (header->terminalCount > symbols) throw fail("more terminals than symbols");
+  if (g->nameOffsets[0] != 0 || g->nameOffsets[symbols] != header->nameBytes) throw fail("bad name table");
+  for (size_t s = 0; s < symbols; s++) {
+    if (g->nameOffsets[s] >= g->nameOffsets[s + 1]) throw fail("bad name table");
+    if (s < header->terminalCount && g->symbolName((uint32_t)s).size() != 1) {
+      throw fail("terminal \"" + std::string(g->symbolName((uint32_t)s)) + "\" not single-char");
+    }
+  }
+  if (header->start < header->terminalCount || header->start >= symbols) throw fail("bad start symbol");
+  if (g->bodyOffsets[0] != 0 || g->bodyOffsets[productions] != header->bodySymbolCount) {
+    throw fail("bad production table");
+  }
+  for (size_t p = 0; p < productions; p++) {
+    if (g->heads[p] < header->terminalCount || g->heads[p] >= symbols ||
+        g->bodyOffsets[p] > g->bodyOffsets[p + 1]) {
+      throw fail("bad production table");
+    }
+  }
+  for (size_t i = 0; i < header->bodySymbolCount; i++) {
+    if (g->bodySymbols[i] >= symbols) throw fail("body symbol out of range");
+  }
+  return g;
+}
+
+/**************************************************
+ * Conversion
+ **************************************************/
+
+void BinaryGrammar::write(const CFG &cfg, const std::string &path) {
+  // GrammarIndex does the numbering: its id k is file symbol k - 1 (no
+  // end marker), its rule r is production r - 1 (no augmented rule)
+  GrammarIndex index(cfg);
+  if (index.isTerminal(index.startSymbol())) {
+    throw std::runtime_error("Start symbol " + cfg.getStartSymbol() + " is a terminal");
+  }
+  size_t symbols = index.symbolCount() - 2;  // without "$" and S'
+  size_t productions = index.ruleCount() - 1;
+
+  std::vector<uint32_t> nameOffsets{0};
+  std::string names;
+  std::vector<uint8_t> flags;
+  for (SymbolId id = 1; id <= (SymbolId)symbols; id++) {
+    const std::string &name = index.symbolName(id);
+    names += name;
+    nameOffsets.push_back((uint32_t)names.size());
+    flags.push_back(cfg.getNonTerminals().count(name) ? Declared : 0);
+  }
+
+  std::vector<uint32_t> heads, bodyOffsets{0}, bodySymbols;
+  for (int r = 1; r <= (int)productions; r++) {
+    heads.push_back(uint32_t(index.ruleHead(r) - 1));
+    for (SymbolId sym : index.ruleBody(r)) bodySymbols.push_back(uint32_t(sym - 1));
+    bodyOffsets.push_back((uint32_t)bodySymbols.size());
+  }
+  if (names.size() > std::numeric_limits<uint32_t>::max() ||
+      bodySymbols.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("Grammar too large for the .cfgb format");
+  }
+
+  Header header{};
+  std::memcpy(header.magic, "CFGB", 4);
+  header.version = FormatVersion;
+  header.byteOrder = ByteOrderMark;
+  header.start = uint32_t(index.startSymbol() - 1);
+  header.fingerprint = cfg.fingerprint();
+  header.symbolCount = symbols;
+  header.terminalCount = index.terminalCount() - 1;
+  header.productionCount = productions;
+  header.bodySymbolCount = bodySymbols.size();
+  header.nameBytes = names.size();
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) throw std::runtime_error("Unable to write " + path);
+  auto section = [&](const void *data, size_t bytes) {
+    static const char zeros[8] = {};
+    file.write(static_cast<const char *>(data), (std::streamsize)bytes);
+    file.write(zeros, (std::streamsize)(aligned(bytes) - bytes));
+  };
+  section(&header, sizeof(header));
+  section(nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+  section(names.data(), names.size());
+  section(flags.data(), flags.size());
+  section(heads.data(), heads.size() * sizeof(uint32_t));
+  section(bodyOffsets.data(), bodyOffsets.size() * sizeof(uint32_t));
+  section(bodySymbols.data(), bodySymbols.size() * sizeof(uint32_t));
+  if (!file) throw std::runtime_error("Unable to write " + path);
+}
@@ -0,0 +1,105 @@
+/**************************************************
+* BinaryGrammar.h - Memory-mappable binary grammar (.cfgb)
+*
+* Usage:
+*   BinaryGrammar::write(CFG("grammar.json"), "grammar.cfgb");   // convert once
+*   auto g = BinaryGrammar::open("grammar.cfgb");                // mmap, no parsing
+*   auto compiled = CompiledGrammar::compile(*g);
+*   CFG cfg("grammar.cfgb");     // the CFG constructor reads both formats
+*
+* The file holds the grammar exactly as GrammarIndex numbers it, so
+* open() only maps the file and checks it; every accessor reads the
+* mapping directly. Symbols are numbered like GrammarIndex without the
+* end marker: terminals first (sorted by character), then the
+* nonterminals. Productions are in the CFG's order, so production p is
+* GrammarIndex rule p + 1.
+*
+* Layout, native byte order, sections 8-byte aligned:
+*   header    (magic "CFGB", version, byte order mark, start symbol,
+*              CFG::fingerprint() of the source, section sizes)
+*   uint32_t  nameOffsets[symbolCount + 1]     name of s is [off[s], off[s+1])
+*   char      names[nameBytes]
+*   uint8_t   symbolFlags[symbolCount]         Declared: listed in "Variables"
+*   uint32_t  heads[productionCount]
+*   uint32_t  bodyOffsets[productionCount + 1]
+*   uint32_t  bodySymbols[bodySymbolCount]
+**************************************************/
+
+#ifndef BINARYGRAMMAR_H
+#define BINARYGRAMMAR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "CFG.h"
+#include "GrammarIndex.h"
+
+class MappedFile;
+
+class BinaryGrammar {
+public:
+ // Bumped whenever the layout or CFG::fingerprint() changes
+ static constexpr uint32_t FormatVersion = 2;
+
+ enum SymbolFlag : uint8_t { Declared = 1 };
+
+ // Maps `path`; throws std::runtime_error if it is not a well-formed
+ // .cfgb file of this version and byte order
+ static std::shared_ptr<const BinaryGrammar> open(const std::string &path);
+ // True if `path` starts with the .cfgb magic (any version)
+ static bool isBinaryGrammarFile(const std::string &path);
+ // Converts cfg; throws std::runtime_error when the file cannot be written
+ static void write(const CFG &cfg, const std::string &path);
+
+ // ---- Symbols ----
+ size_t symbolCount() const { return header->symbolCount; }
+ size_t terminalCount() const { return header->terminalCount; }
+ bool isTerminal(uint32_t s) const { return s < header->terminalCount; }
+ bool isDeclared(uint32_t s) const { return (symbolFlags[s] & Declared) != 0; }
+ std::string_view symbolName(uint32_t s) const {
+   return {names + nameOffsets[s], size_t(nameOffsets[s + 1] - nameOffsets[s])};
+ }
+ uint32_t startSymbol() const { return header->start; }
+
+ // ---- Productions ----
+ size_t productionCount() const { return header->productionCount; }
+ size_t bodySymbolCount() const { return header->bodySymbolCount; }
+ uint32_t productionHead(size_t p) const { return heads[p]; }
+ IdRange<uint32_t> productionBody(size_t p) const {
+   return {bodySymbols + bodyOffsets[p], bodySymbols + bodyOffsets[p + 1]};
+ }
+
+ // CFG::fingerprint() of the grammar this file was written from, which
+ // is also the fingerprint of the CFG read back from it
+ uint64_t fingerprint() const { return header->fingerprint; }
+
+private:
+ struct Header {
+   char magic[4];          // "CFGB"
+   uint32_t version;
+   uint32_t byteOrder;     // ByteOrderMark as written by the producer
+   uint32_t start;
+   uint64_t fingerprint;
+   uint64_t symbolCount;
+   uint64_t terminalCount;
+   uint64_t productionCount;
+   uint64_t bodySymbolCount;
+   uint64_t nameBytes;
+ };
+ static_assert(sizeof(Header) == 64, "the .cfgb header is 64 bytes");
+
+ BinaryGrammar() = default;
+
+ std::shared_ptr<const MappedFile> storage;
+ const Header *header = nullptr;
+ const uint32_t *nameOffsets = nullptr;
+ const char *names = nullptr;
+ const uint8_t *symbolFlags = nullptr;
+ const uint32_t *heads = nullptr;
+ const uint32_t *bodyOffsets = nullptr;
+ const uint32_t *bodySymbols = nullptr;
+};
+
+#endif // BINARYGRAMMAR_H
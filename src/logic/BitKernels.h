@@ -0,0 +1,95 @@
+/**************************************************
+* BitKernels.h - Word-parallel operations on packed bitsets
+*
+* A bitset is a plain array of uint64_t words, bit i of the set
+* is bit (i & 63) of word (i >> 6). The CYK engines keep one such
+* set per table cell and combine them with these kernels.
+*
+* Built with AVX2 (cmake -DCFG_ENABLE_AVX2=ON, or -mavx2 /
+* -march=native) the loops run four words at a time; otherwise the
+* scalar loops are used. tests/bit_kernels_test.cpp checks both.
+**************************************************/
+
+#ifndef BITKERNELS_H
+#define BITKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Words needed for a set of `bits` bits
+inline size_t bitWords(size_t bits) { return (bits + 63) / 64; }
+
+inline bool testBit(const uint64_t *set, size_t bit) {
+  return (set[bit >> 6] >> (bit & 63)) & 1;
+}
+
+inline void setBit(uint64_t *set, size_t bit) {
+  set[bit >> 6] |= uint64_t(1) << (bit & 63);
+}
+
+// dst |= src
+inline void orWords(uint64_t *dst, const uint64_t *src, size_t words) {
+  size_t w = 0;
+#ifdef __AVX2__
+  for (; w + 4 <= words; w += 4) {
+    __m256i d = _mm256_loadu_si256((const __m256i *)(dst + w));
+    __m256i s = _mm256_loadu_si256((const __m256i *)(src + w));
+    _mm256_storeu_si256((__m256i *)(dst + w), _mm256_or_si256(d, s));
+  }
+#endif
+  for (; w < words; w++) dst[w] |= src[w];
+}
+
+// dst = a & b, true if the result is not empty
+inline bool andWords(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words) {
+  size_t w = 0;
+  uint64_t any = 0;
+#ifdef __AVX2__
+  __m256i acc = _mm256_setzero_si256();
+  for (; w + 4 <= words; w += 4) {
+    __m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(a + w)),
+                                 _mm256_loadu_si256((const __m256i *)(b + w)));
+    _mm256_storeu_si256((__m256i *)(dst + w), x);
+    acc = _mm256_or_si256(acc, x);
+  }
+  any = !_mm256_testz_si256(acc, acc);
+#endif
+  for (; w < words; w++) {
+    dst[w] = a[w] & b[w];
+    any |= dst[w];
+  }
+  return any != 0;
+}
+
+// true if some bit is set
+inline bool anyWords(const uint64_t *set, size_t words) {
+  size_t w = 0;
+#ifdef __AVX2__
+  for (; w + 4 <= words; w += 4) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(set + w));
+    if (!_mm256_testz_si256(x, x)) return true;
+  }
+#endif
+  for (; w < words; w++) {
+    if (set[w]) return true;
+  }
+  return false;
+}
+
+// Calls f(bit) for every set bit, in increasing order
+template <typename F>
+inline void forEachBit(const uint64_t *set, size_t words, F &&f) {
+  for (size_t w = 0; w < words; w++) {
+    uint64_t word = set[w];
+    while (word) {
+      f(w * 64 + (size_t)__builtin_ctzll(word));
+      word &= word - 1;
+    }
+  }
+}
+
+#endif // BITKERNELS_H
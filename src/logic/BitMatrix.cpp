@@ -0,0 +1,77 @@
+#include "BitMatrix.h"
+#include "BitKernels.h"
+#include <algorithm>
+
+// Blocks from this size on are multiplied with the Four Russians tables
+static constexpr size_t FourRussiansMin = 256;
+
+void BitMatrix::resize(size_t size) {
+  n = size;
+  stride = std::max<size_t>(1, bitWords(size));
+  bits.assign(n * stride, 0);
+}
+
+void BitMatrix::clear() {
+  std::fill(bits.begin(), bits.end(), 0);
+}
+
+// Bits [from, from + s) of a row, s < 64 and inside one word
+static inline uint64_t subWord(const uint64_t *row, size_t from, size_t s) {
+  return (row[from >> 6] >> (from & 63)) & ((uint64_t(1) << s) - 1);
+}
+
+bool BitMatrix::anyInBlock(size_t r, size_t c, size_t s) const {
+  for (size_t i = r; i < r + s; i++) {
+    if (s >= 64 ? anyWords(row(i) + (c >> 6), s >> 6) : subWord(row(i), c, s) != 0) return true;
+  }
+  return false;
+}
+
+void orMultiply(BitMatrix &dst, const BitMatrix &a, const BitMatrix &b,
+                size_t x, size_t z, size_t y, size_t s) {
+  if (!a.anyInBlock(x, z, s) || !b.anyInBlock(z, y, s)) return;
+
+  // Small blocks: the columns Y are part of one word
+  if (s < 64) {
+    uint64_t maskY = ((uint64_t(1) << s) - 1) << (y & 63);
+    for (size_t i = x; i < x + s; i++) {
+      uint64_t ks = subWord(a.row(i), z, s);
+      uint64_t acc = 0;
+      while (ks) {
+        acc |= b.row(z + (size_t)__builtin_ctzll(ks))[y >> 6];
+        ks &= ks - 1;
+      }
+      dst.row(i)[y >> 6] |= acc & maskY;
+    }
+    return;
+  }
+
+  size_t yw = y >> 6, words = s >> 6;
+  if (s < FourRussiansMin) {
+    // Row i of the product is the union of the rows k of b with a[i][k]
+    for (size_t i = x; i < x + s; i++) {
+      forEachBit(a.row(i) + (z >> 6), words, [&](size_t k) {
+        orWords(dst.row(i) + yw, b.row(z + k) + yw, words);
+      });
+    }
+    return;
+  }
+
+  // Four Russians: for each group of 8 rows of b, table[m] is the union
+  // of the rows selected by the bits of m, so each row of a needs one
+  // table lookup per group instead of up to 8 row unions.
+  std::vector<uint64_t> table(256 * words);
+  for (size_t k0 = z; k0 < z + s; k0 += 8) {
+    std::fill(table.begin(), table.begin() + words, 0);
+    for (size_t m = 1; m < 256; m++) {
+      const uint64_t *rest = &table[(m & (m - 1)) * words];
+      const uint64_t *low = b.row(k0 + (size_t)__builtin_ctzll(m)) + yw;
+      uint64_t *entry = &table[m * words];
+      for (size_t w = 0; w < words; w++) entry[w] = rest[w] | low[w];
+    }
+    for (size_t i = x; i < x + s; i++) {
+      size_t m = (a.row(i)[k0 >> 6] >> (k0 & 63)) & 0xFF;
+      if (m) orWords(dst.row(i) + yw, &table[m * words], words);
+    }
+  }
+}
@@ -0,0 +1,50 @@
+/**************************************************
+* BitMatrix.h - Square Boolean matrices packed into 64-bit words
+*
+* Row i is a bitset of rowWords() words, bit j of the row is entry
+* (i, j). orMultiply adds the Boolean product of two blocks to a
+* third one; ValiantParser reduces CYK to these products.
+**************************************************/
+
+#ifndef BITMATRIX_H
+#define BITMATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class BitMatrix {
+public:
+ BitMatrix() = default;
+ explicit BitMatrix(size_t size) { resize(size); }
+
+ // size x size, all entries false
+ void resize(size_t size);
+ void clear();
+
+ size_t size() const { return n; }
+ size_t rowWords() const { return stride; }
+ uint64_t *row(size_t i) { return bits.data() + i * stride; }
+ const uint64_t *row(size_t i) const { return bits.data() + i * stride; }
+
+ bool get(size_t i, size_t j) const { return (row(i)[j >> 6] >> (j & 63)) & 1; }
+ void set(size_t i, size_t j) { row(i)[j >> 6] |= uint64_t(1) << (j & 63); }
+
+ // true if the block rows [r, r+s) x columns [c, c+s) has a true entry
+ bool anyInBlock(size_t r, size_t c, size_t s) const;
+
+private:
+ size_t n = 0;
+ size_t stride = 0;
+ std::vector<uint64_t> bits;
+};
+
+// dst[X, Y] |= a[X, Z] * b[Z, Y] for the s x s blocks starting at rows
+// x (dst, a), z (b) and columns z (a), y (dst, b). Blocks are aligned:
+// x, y, z are multiples of s, and s is a power of two.
+// Large blocks use the Four Russians method (8 rows of b at a time are
+// combined into a 256-entry table of their unions).
+void orMultiply(BitMatrix &dst, const BitMatrix &a, const BitMatrix &b,
+                size_t x, size_t z, size_t y, size_t s);
+
+#endif // BITMATRIX_H
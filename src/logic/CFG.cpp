@@ -3,10 +3,16 @@
 //
 
 #include "CFG.h"
-#include <regex>
-#include <queue>
+#include "EarleyParser.h"
+#include "CNFConverter.h"
+#include "BinaryGrammar.h"
 
 CFG::CFG(std::string Filename) {
+  if (BinaryGrammar::isBinaryGrammarFile(Filename)) {
+    readBinary(*BinaryGrammar::open(Filename));
+    return;
+  }
+
   std::ifstream input(Filename);
   if (!input) {
     throw std::runtime_error("Unable to open file " + Filename);
@@ -35,16 +41,15 @@ CFG::CFG(std::string Filename) {
   for (const auto &prod : j["Productions"]) {
     std::string head = prod["head"].get<std::string>();
 
-    // Build the body as a concatenation of single-char symbols
-    std::string body;
+    // Terminals are single characters, nonterminals may have longer
+    // names as long as they are declared in "Variables"
+    std::vector<std::string> body;
     for (auto &symJson : prod["body"]) {
       std::string sym = symJson.get<std::string>();
-      // If your grammar truly only allows single-char symbols in the body,
-      // check sym.size() == 1:
-      if (sym.size() != 1) {
-        throw std::runtime_error("Error: multi-char symbol \"" + sym + "\" found. Only single-char symbols supported.\n");
+      if (sym.size() != 1 && !nonTerminals.count(sym)) {
+        throw std::runtime_error("Error: multi-char symbol \"" + sym + "\" is not a declared variable.\n");
       }
-      body += sym;
+      body.push_back(std::move(sym));
     }
 
     productionRules[head].push_back(body);
@@ -54,6 +59,26 @@ CFG::CFG(std::string Filename) {
   startSymbol = j["Start"].get<std::string>();
 }
 
+// The sets and maps the JSON path would have built: declared symbols go
+// to nonTerminals, bodies get their symbol names back
+void CFG::readBinary(const BinaryGrammar &binary) {
+  for (uint32_t s = 0; s < binary.symbolCount(); s++) {
+    if (binary.isTerminal(s)) terminals.insert(binary.symbolName(s)[0]);
+    if (binary.isDeclared(s)) nonTerminals.emplace(binary.symbolName(s));
+  }
+
+  vector<vector<vector<string>> *> bodiesOf(binary.symbolCount(), nullptr);
+  for (size_t p = 0; p < binary.productionCount(); p++) {
+    uint32_t head = binary.productionHead(p);
+    if (!bodiesOf[head]) bodiesOf[head] = &productionRules[string(binary.symbolName(head))];
+    vector<string> body;
+    for (uint32_t sym : binary.productionBody(p)) body.emplace_back(binary.symbolName(sym));
+    bodiesOf[head]->push_back(std::move(body));
+  }
+
+  startSymbol = string(binary.symbolName(binary.startSymbol()));
+}
+
 void CFG::print() {
     // Print non-terminals
     cout << "V = {";
@@ -76,7 +101,9 @@ void CFG::print() {
     vector<string> productionStrings;
     for (const auto& rule : productionRules) {
         for (const auto& prod : rule.second) {
-            string productionStr = "  " + rule.first + " -> `" + prod + "`\n";
+            string productionStr = "  " + rule.first + " -> `";
+            for (const auto& sym : prod) productionStr += sym;
+            productionStr += "`\n";
             productionStrings.push_back(productionStr);
         }
     }
@@ -98,530 +125,174 @@ void CFG::print() {
 
 
 
-void CFG::eliminateEpsilonProductions() {
-    set<string> nullable;
-
-    // Stap 1: Bepaal nullable variabelen
-    for (const auto& rule : productionRules) {
-        for (const auto& body : rule.second) {
-            if (body.empty()) {
-                nullable.insert(rule.first);
-            }
-        }
+CNFReport CFG::toCNF(bool verbose) {
+    if (verbose) {
+        cout << "Original CFG:\n\n";
+        print();
+        cout << "\n-------------------------------------\n\n";
     }
 
-    bool changed;
-    do {
-        changed = false;
-        for (const auto& rule : productionRules) {
-            for (const auto& body : rule.second) {
-                bool allNullable = true;
-                for (char symbol : body) {
-                    if (!nullable.count(string(1, symbol))) {
-                        allNullable = false;
-                        break;
-                    }
-                }
-                if (allNullable && nullable.insert(rule.first).second) {
-                    changed = true;
-                }
-            }
-        }
-    } while (changed);
+    CNFConverter converter(*this);
+    CNFReport report = converter.run();
+    converter.writeTo(*this);
+    cnfProvenance = converter.provenance();
 
-    // Log de nullables
-    cout << "  Nullables are {";
-    for (auto it = nullable.begin(); it != nullable.end(); ++it) {
-        cout << *it;
-        if (next(it) != nullable.end()) cout << ", ";
+    if (verbose) {
+        report.print(cout);
+        cout << ">>> Result CFG:\n\n";
+        print();
     }
-    cout << "}\n";
-
-    // Stap 2: Creëer nieuwe producties door nullable variabelen te verwijderen
-    map<string, vector<string>> newProductions;
-    for (const auto& rule : productionRules) {
-        for (const auto& body : rule.second) {
-            vector<string> bodies = {body};
-
-            // Verwijder nullable variabelen
-            for (size_t i = 0; i < body.size(); ++i) {
-                if (nullable.count(string(1, body[i]))) {
-                    size_t currentSize = bodies.size();
-                    for (size_t j = 0; j < currentSize; ++j) {
-                        string newBody = bodies[j];
-                        newBody.erase(remove(newBody.begin(), newBody.end(), body[i]), newBody.end());
-
-                        // Voeg alleen unieke en niet-lege producties toe, zonder dubbele spaties
-                        newBody.erase(unique(newBody.begin(), newBody.end(), [](char a, char b) { return a == ' ' && b == ' '; }), newBody.end());
-                        if (!newBody.empty() && find(bodies.begin(), bodies.end(), newBody) == bodies.end()) {
-                            bodies.push_back(newBody);
-                        }
-                    }
-                }
-            }
-
-            // Verwijder extra spaties en voeg producties toe
-            for (auto& newBody : bodies) {
-                newBody = regex_replace(newBody, regex("^ +| +$|( ) +"), "$1");  // Verwijder begin/eindspaties en dubbele spaties
-                if (!newBody.empty()) newProductions[rule.first].push_back(newBody);
-            }
-        }
-    }
-
-    // Stap 3: Verwijder lege producties en sorteer producties voor ASCII-volgorde
-    for (auto& rule : newProductions) {
-        auto& bodies = rule.second;
-        bodies.erase(remove(bodies.begin(), bodies.end(), ""), bodies.end());
-    }
-
-    // Stap 4: Log productietellingen
-    size_t originalProdCount = 0;
-    for (const auto& rule : productionRules) {
-        originalProdCount += rule.second.size();
-    }
-    size_t newProdCount = 0;
-    for (const auto& rule : newProductions) {
-        newProdCount += rule.second.size();
-    }
-    cout << "  Created " << newProdCount << " productions, original had " << originalProdCount << "\n\n";
-
-    // Update de productie regels
-    productionRules = newProductions;
+    return report;
 }
 
-
-
-
-void CFG::eliminateUnitProductions() {
-    std::set<std::pair<std::string, std::string>> unitPairs;
-    std::set<std::pair<std::string, std::string>> directUnitPairs;
-    for (const auto& nt : nonTerminals) {
-        unitPairs.insert({nt, nt});
-    }
-    for (const auto& rule : productionRules) {
-        for (const auto& prod : rule.second) {
-            if (nonTerminals.count(prod)) {
-                unitPairs.insert({rule.first, prod});
-                directUnitPairs.insert({rule.first, prod});
-            }
-        }
-    }
-
-    bool changed;
-    do {
-        changed = false;
-        for (const auto& [A, B] : unitPairs) {
-            for (const auto& [C, D] : unitPairs) {
-                if (B == C && unitPairs.insert({A, D}).second) {
-                    changed = true;
-                }
-            }
-        }
-    } while (changed);
-
-    std::set<std::pair<std::string, std::string>> uniqueProductions;
-    int originalProdCount = 0;
-    for (const auto& rule : productionRules) {
-        originalProdCount += rule.second.size();
-        for (const auto& body : rule.second) {
-            if (!nonTerminals.count(body)) {
-                uniqueProductions.insert({rule.first, body});
-            }
-        }
-    }
-
-    for (const auto& [A, B] : unitPairs) {
-        for (const auto& body : productionRules[B]) {
-            if (!nonTerminals.count(body)) {
-                uniqueProductions.insert({A, body});
-            }
-        }
-    }
-
-    // Converteer unieke producties terug naar map-structuur
-    productionRules.clear();
-    for (const auto& [head, body] : uniqueProductions) {
-        productionRules[head].push_back(body);
-    }
-
-    postUnitProdCount = uniqueProductions.size();
-
-    std::cout << " >> Eliminating unit pairs\n";
-    std::cout << "  Found " << directUnitPairs.size() << " unit productions\n";
-    std::cout << "  Unit pairs: {";
-    for (auto it = unitPairs.begin(); it != unitPairs.end(); ++it) {
-        std::cout << "(" << it->first << ", " << it->second << ")";
-        if (std::next(it) != unitPairs.end()) std::cout << ", ";
-    }
-    std::cout << "}\n";
-    std::cout << "  Created " << uniqueProductions.size() << " new productions" << ", original had " << originalProdCount << "\n";
-
-}
-
-
-
-void CFG::removeUselessSymbols() {
-    int initialVariableCount = nonTerminals.size();
-    int initialProdCount = postUnitProdCount;
-    int initialTerminalCount = terminals.size();
-
-    // Stap 1: Genereerbare symbolen vinden (inclusief terminals)
-    set<string> generatingSymbols;
-    for (char terminal : terminals) {
-        generatingSymbols.insert(string(1, terminal));
-    }
-
-    bool changed;
-    do {
-        changed = false;
-        for (const auto& rule : productionRules) {
-            const string& head = rule.first;
-            for (const auto& body : rule.second) {
-                bool allGenerating = true;
-                for (char symbol : body) {
-                    string symStr(1, symbol);
-                    if (nonTerminals.count(symStr) && !generatingSymbols.count(symStr)) {
-                        allGenerating = false;
-                        break;
-                    }
-                }
-                if (allGenerating && generatingSymbols.insert(head).second) {
-                    changed = true;
-                }
-            }
-        }
-    } while (changed);
-
-    // Niet-genereerbare symbolen verwijderen
-    for (auto it = productionRules.begin(); it != productionRules.end();) {
-        if (!generatingSymbols.count(it->first)) {
-            it = productionRules.erase(it);
-        } else {
-            it->second.erase(remove_if(it->second.begin(), it->second.end(),
-                                       [&](const string& body) {
-                                           for (char symbol : body) {
-                                               if (nonTerminals.count(string(1, symbol)) && !generatingSymbols.count(string(1, symbol))) {
-                                                   return true;
-                                               }
-                                           }
-                                           return false;
-                                       }), it->second.end());
-            ++it;
-        }
-    }
-
-    // Bereikbare symbolen vinden (startend bij startSymbool)
-    set<string> reachableSymbols = {startSymbol};
-    queue<string> toProcess;
-    toProcess.push(startSymbol);
-    while (!toProcess.empty()) {
-        string current = toProcess.front();
-        toProcess.pop();
-        for (const auto& body : productionRules[current]) {
-            for (char symbol : body) {
-                string symStr(1, symbol);
-                if (terminals.count(symbol)) {
-                    reachableSymbols.insert(symStr); // Voeg terminal toe als hij wordt aangetroffen
-                } else if (nonTerminals.count(symStr) && reachableSymbols.insert(symStr).second) {
-                    toProcess.push(symStr);
-                }
-            }
-        }
-    }
-
-    // Niet-bereikbare symbolen verwijderen
-    for (auto it = productionRules.begin(); it != productionRules.end();) {
-        if (!reachableSymbols.count(it->first)) {
-            it = productionRules.erase(it);
-        } else {
-            it->second.erase(remove_if(it->second.begin(), it->second.end(),[&](const string& body) {
-                for (char symbol : body) {
-                    if (nonTerminals.count(string(1, symbol)) && !reachableSymbols.count(string(1, symbol))) {
-                        return true;
-                    }
-                }
-                return false;
-            }), it->second.end());
-            ++it;
-        }
-    }
-
-    // Verzamelen van overgebleven producties in een vector (inclusief duplicaten)
-    vector<pair<string, string>> remainingProductions;
-    for (const auto& rule : productionRules) {
-        for (const auto& body : rule.second) {
-            remainingProductions.push_back({rule.first, body});
-        }
-    }
-
-    // Update nonTerminals met de uiteindelijke bruikbare symbolen (exclusief terminals)
-    set<string> usefulSymbols;
-    set_intersection(generatingSymbols.begin(), generatingSymbols.end(),
-                     reachableSymbols.begin(), reachableSymbols.end(),
-                     inserter(usefulSymbols, usefulSymbols.begin()));
-    nonTerminals.clear();
-    for (const auto& symbol : usefulSymbols) {
-        if (!terminals.count(symbol[0])) { // Voeg alleen niet-terminals toe aan V
-            nonTerminals.insert(symbol);
-        }
+void CNFReport::print(ostream &out) const {
+    out << " >> Breaking long bodies\n";
+    out << "  Broke " << brokenBodies << " bodies, added " << helperVariables << " new variables";
+    if (helperVariables < unsharedHelpers) {
+        out << " (" << unsharedHelpers << " without sharing " << (sharedPrefixes ? "prefixes" : "suffixes") << ")";
     }
+    out << "\n  Created " << afterBinarize << " productions, original had " << originalProductions << "\n\n";
 
-    // Print resultaten
-    cout << " >> Eliminating useless symbols\n";
-    cout << "  Generating symbols: {";
-    for (auto it = generatingSymbols.begin(); it != generatingSymbols.end(); ++it) {
-        cout << *it;
-        if (next(it) != generatingSymbols.end()) cout << ", ";
+    out << " >> Eliminating epsilon productions\n";
+    out << "  Nullables are {";
+    for (size_t i = 0; i < nullable.size(); i++) {
+        out << (i ? ", " : "") << nullable[i];
     }
-    cout << "}\n";
+    out << "}\n";
+    out << "  Created " << afterEpsilon << " productions, binarized had " << afterBinarize << "\n\n";
 
-    cout << "  Reachable symbols: {";
-    for (auto it = reachableSymbols.begin(); it != reachableSymbols.end(); ++it) {
-        cout << *it;
-        if (next(it) != reachableSymbols.end()) cout << ", ";
-    }
-    cout << "}\n";
+    out << " >> Eliminating unit pairs\n";
+    out << "  Found " << unitProductions << " unit productions\n";
+    out << "  Unit pairs: " << unitPairs << "\n";
+    out << "  Created " << afterUnit << " new productions, original had " << afterEpsilon << "\n\n";
 
-    cout << "  Useful symbols: {";
-    for (auto it = usefulSymbols.begin(); it != usefulSymbols.end(); ++it) {
-        cout << *it;
-        if (next(it) != usefulSymbols.end()) cout << ", ";
-    }
-    cout << "}\n";
+    out << " >> Eliminating useless symbols\n";
+    out << "  Removed " << removedVariables << " variables and " << (afterUnit - afterUseless) << " productions\n\n";
 
-    // Verwijderde producties berekenen
-    int removedVariables = initialVariableCount - nonTerminals.size();
-    int removedTerminals = initialTerminalCount - terminals.size();
-    int remainingProdCount = 0;
-    for (const auto& rule : productionRules) {
-        remainingProdCount += rule.second.size();
+    out << " >> Replacing terminals in bad bodies\n";
+    out << "    Added " << terminalVariables.size() << " new variables: {";
+    for (size_t i = 0; i < terminalVariables.size(); i++) {
+        out << (i ? ", " : "") << terminalVariables[i];
     }
-    int removedProductions = initialProdCount - remainingProdCount;
-    postUselessProdCount = remainingProdCount;
-    cout << "  Removed " << removedVariables << " variables, "<< removedTerminals <<" terminals and " << removedProductions << " productions\n\n";
+    out << "}\n";
+    out << "    Created " << afterTerminals << " new productions, original had " << afterUseless << "\n\n";
 }
 
-void CFG::replaceTerminalsInBadBodies() {
-    // Map of terminals to their corresponding non-terminals for direct replacements
-    map<char, string> terminalToNonTerminal = {
-            {'a', "A"},
-            {'b', "B"}
-    };
-
-    map<char, string> terminalToVar;  // New variables for terminals without direct non-terminal replacements
-    int newVariableCount = 0;
-
-    // Process each production rule
-    for (auto& rule : productionRules) {
-        vector<string> updatedBodies;
-
-        for (const string& body : rule.second) {
-            // If the body is a single terminal, keep it as-is
-            if (body.size() == 1 && terminals.count(body[0])) {
-                updatedBodies.push_back(body);
-                continue;
-            }
-
-            string newBody;
-            bool bodyModified = false;
-            set<char> uniqueTerminals;  // Track unique terminals in the body
-
-            // First pass: collect unique terminals
-            for (char symbol : body) {
-                if (terminals.count(symbol)) {
-                    uniqueTerminals.insert(symbol);
-                }
-            }
-
-            // Determine if we need new variables
-            bool useNewVariables = uniqueTerminals.size() > 1;
-
-            // Process each symbol in the body
-            for (char symbol : body) {
-                if (terminals.count(symbol) && body.size() >= 2) {
-                    if (useNewVariables) {
-                        // Create a new variable for this terminal if needed
-                        if (terminalToVar.find(symbol) == terminalToVar.end()) {
-                            string newVar = "_" + string(1, symbol);
-                            terminalToVar[symbol] = newVar;
-                            nonTerminals.insert(newVar);
-                            productionRules[newVar].push_back(string(1, symbol));
-                            newVariableCount++;
-                        }
-                        newBody += terminalToVar[symbol];
-                    } else if (terminalToNonTerminal.find(symbol) != terminalToNonTerminal.end()) {
-                        // Replace with corresponding non-terminal if exists
-                        newBody += terminalToNonTerminal[symbol];
-                    }
-                    bodyModified = true;
-                } else {
-                    newBody += symbol;
-                }
-            }
-
-            // Add the modified or original body as needed
-            updatedBodies.push_back(bodyModified ? newBody : body);
-        }
-        rule.second = updatedBodies;
-    }
-
-    // Print results
-    cout << "    Added " << newVariableCount << " new variables: {";
-    for (auto it = terminalToVar.begin(); it != terminalToVar.end(); ++it) {
-        cout << it->second;
-        if (next(it) != terminalToVar.end()) cout << ", ";
-    }
-    cout << "}" << endl;
-
-    int totalProdCount = 0;
-    for (const auto& rule : productionRules) {
-        totalProdCount += rule.second.size();
-    }
-    cout << "    Created " << totalProdCount << " new productions, original had " << postUselessProdCount << "\n\n";
+string AmbiguityReport::verdictName() const {
+  switch (verdict) {
+    case NotDerivable: return "0";
+    case Unambiguous: return "1";
+    case Ambiguous: return "many";
+    case InfinitelyAmbiguous: return "infinite (cyclic)";
+  }
+  return "?";
 }
 
+AmbiguityReport CFG::checkAmbiguity(const string &testString, size_t samples) const {
+  AmbiguityReport report;
 
+  // One Earley pass builds the shared forest of all parse trees; counting
+  // the trees in it is a single walk, so no derivation is ever enumerated.
+  EarleyParser parser(*this);
+  parser.setBuildForest(true);
+  if (!parser.parse(testString)) {
+    return report;
+  }
 
+  const ParseForest &forest = parser.getForest();
+  TreeCount count = forest.countTrees();
+  report.treeCount = count.count;
+  report.countSaturated = count.saturated;
+  if (count.infinite) {
+    report.verdict = AmbiguityReport::InfinitelyAmbiguous;
+  } else if (count.count > 1 || count.saturated) {
+    report.verdict = AmbiguityReport::Ambiguous;
+  } else {
+    report.verdict = AmbiguityReport::Unambiguous;
+  }
 
-
-void CFG::breakLongBodies() {
-    map<string, vector<string>> newProductions;
-    map<string, int> varCount;  // Counter for each non-terminal to start from 2
-    int brokeCount = 0;  // Counter to track how many bodies were broken down
-
-    // Iterate over all production rules
-    for (const auto& rule : productionRules) {
-        const string& head = rule.first;
-        varCount[head] = 1;  // Initialize the counter for this non-terminal to start from 1
-
-        for (const auto& body : rule.second) {
-            // Split the body into individual symbols
-            vector<string> parts;
-            istringstream iss(body);
-            string part;
-            while (iss >> part) {
-                parts.push_back(part);
-            }
-
-            if (parts.size() > 2) {
-                brokeCount++;
-                string currentHead = head;
-
-                // Process each segment of the body, creating a chain of new variables
-                for (size_t i = 0; i < parts.size() - 2; ++i) {
-                    string first = parts[i];
-                    string newVar = head + "_" + to_string(++varCount[head]);  // Generate new variable, starting from 2
-                    nonTerminals.insert(newVar);
-
-                    // Add the current production as `currentHead -> first newVar`
-                    newProductions[currentHead].push_back(first + " " + newVar);
-
-                    // Move to the next part, updating the head to newVar
-                    currentHead = newVar;
-                }
-
-                // The last segment (two symbols) is added as a final binary rule
-                newProductions[currentHead].push_back(parts[parts.size() - 2] + " " + parts[parts.size() - 1]);
-
-            } else {
-                // If body has 2 or fewer symbols, add it directly without modification
-                newProductions[head].push_back(body);
-            }
-        }
-    }
-
-    // Replace the old production rules with the new set
-    productionRules = newProductions;
-
-    cout << "\n >> Broke " << brokeCount << " bodies, added "
-         << accumulate(varCount.begin(), varCount.end(), 0, [](int sum, const std::pair<const std::string, int>& p) {
-             return sum + (p.second - 1);
-         })
-         << " new variables" << endl;
+  // Render sample derivations like "S->AA; A->a; A->ε; "
+  const GrammarIndex &g = parser.getGrammar();
+  for (const auto &rules : forest.sampleDerivations(samples, g)) {
+    string path;
+    for (int r : rules) {
+      path += g.symbolName(g.ruleHead(r)) + "->";
+      if (g.ruleLength(r) == 0) path += "ε";
+      for (SymbolId sym : g.ruleBody(r)) path += g.symbolName(sym);
+      path += "; ";
+    }
+    report.sampleDerivations.push_back(path);
+  }
+  return report;
 }
 
+bool CFG::isAmbiguous(const string &testString) {
+  AmbiguityReport report = checkAmbiguity(testString, 10);
 
+  // Print the derivations for debugging
+  cout << "Derivation paths for \"" << testString << "\":" << endl;
+  for (const auto &path : report.sampleDerivations) {
+    cout << path << endl;
+  }
+  cout << "Parse trees: " << report.verdictName();
+  if (report.verdict == AmbiguityReport::Ambiguous) {
+    cout << " (" << report.treeCount << (report.countSaturated ? "+" : "") << ")";
+  }
+  cout << endl;
 
-
-
-
-void CFG::toCNF() {
-    cout << "Original CFG:\n\n";
-    print();
-    cout << "\n-------------------------------------\n\n";
-
-    cout << " >> Eliminating epsilon productions\n";
-    eliminateEpsilonProductions();
-    print();
-
-    cout << "\n";
-    eliminateUnitProductions();
-    cout << "\n";
-    print();
-
-    cout << "\n";
-    removeUselessSymbols();
-    print();
-
-    cout << "\n >> Replacing terminals in bad bodies\n";
-    // ZORG DAT ALLE PRODUCTION BODIES MET EEN LENGTE >= 2 ENKEL BESTAAN UIT VARIABELEN
-    replaceTerminalsInBadBodies();
-    print();
-
-    //HERSCHRIJF ALLE PRODUCTION BODIES MET LENGTE >= 3 MET EXACT 2 VARIABELEN
-    breakLongBodies();
-
-    cout << ">>> Result CFG:\n\n";
-    print();
+  // If there is more than one parse tree, the CFG is ambiguous
+  return report.verdict >= AmbiguityReport::Ambiguous;
 }
 
-void CFG::generateParsePaths(const string &current, const string &target, vector<string> &paths, string path) {
-  // If we have reached the target, add the current path to the result
-  if (current == target) {
-    paths.push_back(path);
-    return;
-  }
-
-  // Iterate through production rules
+uint64_t CFG::fingerprint() const {
+  // FNV-1a over length-prefixed fields, then a final avalanche
+  uint64_t h = 1469598103934665603ull;
+  auto bytes = [&](const void *data, size_t size) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+      h ^= p[i];
+      h *= 1099511628211ull;
+    }
+  };
+  auto number = [&](uint64_t v) {
+    unsigned char le[8];
+    for (int i = 0; i < 8; i++) le[i] = (unsigned char)(v >> (8 * i));
+    bytes(le, 8);
+  };
+  auto text = [&](const string &s) {
+    number(s.size());
+    bytes(s.data(), s.size());
+  };
+
+  text("cfg2");
+  text(startSymbol);
+  number(terminals.size());
+  for (char t : terminals) bytes(&t, 1);
+  number(nonTerminals.size());
+  for (const auto &nt : nonTerminals) text(nt);
+  number(productionRules.size());
   for (const auto &rule : productionRules) {
-    size_t pos = current.find(rule.first);  // Find all occurrences of the non-terminal
-    while (pos != string::npos) {
-      for (const auto &body : rule.second) {
-        string next = current;
-
-        // If body is empty (A -> ε), replace the non-terminal with an empty string
-        if (body.empty()) {
-          next.replace(pos, rule.first.length(), "");
-          string newPath = path + rule.first + "->ε" + "; ";  // Log ε production
-          generateParsePaths(next, target, paths, newPath);
-        } else {
-          next.replace(pos, rule.first.length(), body);
-          string newPath = path + rule.first + "->" + body + "; ";
-          generateParsePaths(next, target, paths, newPath);
-        }
-      }
-      pos = current.find(rule.first, pos + 1);  // Continue searching after the current position
+    text(rule.first);
+    number(rule.second.size());
+    for (const auto &body : rule.second) {
+      number(body.size());
+      for (const auto &sym : body) text(sym);
     }
   }
-}
 
-bool CFG::isAmbiguous(const string &testString) {
-  vector<string> paths;
-
-  // Generate all possible derivation paths
-  generateParsePaths(startSymbol, testString, paths, "");
-
-  // Print all paths for debugging
-  cout << "Derivation paths for \"" << testString << "\":" << endl;
-  for (const auto &path : paths) {
-    cout << path << endl;
-  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
 
-  // If there are more than one distinct derivation path, the CFG is ambiguous
-  return paths.size() > 1;
+const CNFProvenance *CFG::getCNFProvenance() const {
+  return cnfProvenance.get();
 }
 
-const map<string, vector<string>>& CFG::getProductionRules() const {
+const map<string, vector<vector<string>>>& CFG::getProductionRules() const {
   return productionRules;
 }
 
@@ -2,51 +2,103 @@
 #define PROGRAMEEROPDRACHT1_CFG_H
 
 #include <iostream>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <vector>
 #include <string>
 #include <set>
 #include <iomanip>
 #include <fstream>
-#include "../json.hpp"
+#include "json.hpp"
 
 using namespace std;
 using namespace nlohmann;
 
+// Result of CFG::checkAmbiguity for one input string
+struct AmbiguityReport {
+    enum Verdict { NotDerivable, Unambiguous, Ambiguous, InfinitelyAmbiguous };
+    Verdict verdict = NotDerivable;
+    uint64_t treeCount = 0;            // number of parse trees (if finite)
+    bool countSaturated = false;       // treeCount hit UINT64_MAX, real count is larger
+    vector<string> sampleDerivations;  // leftmost derivations, e.g. "S->AA; A->a; A->ε; "
+
+    string verdictName() const;        // "0", "1", "many", "infinite (cyclic)"
+};
+
+// Statistics of CFG::toCNF, stage by stage
+struct CNFReport {
+    size_t originalProductions = 0;
+    size_t brokenBodies = 0;           // bodies longer than 2
+    size_t helperVariables = 0;        // variables added to break them
+    size_t unsharedHelpers = 0;        // variables a separate chain per body would need
+    bool sharedPrefixes = false;       // helpers stand for shared prefixes, not suffixes
+    size_t afterBinarize = 0;
+    vector<string> nullable;           // nullable variables
+    bool startNullable = false;        // ε was in the language; the CNF grammar drops it
+    size_t afterEpsilon = 0;           // productions after each stage (from afterBinarize on)
+    size_t unitProductions = 0;        // A -> B productions
+    size_t unitPairs = 0;              // (A, B) with A =>* B, including (A, A)
+    size_t afterUnit = 0;
+    size_t removedVariables = 0;       // not generating or not reachable
+    size_t afterUseless = 0;
+    vector<string> terminalVariables;  // new variables X -> a for terminals in long bodies
+    size_t afterTerminals = 0;
+    size_t finalProductions = 0;
+    size_t finalVariables = 0;
+
+    void print(ostream &out) const;
+};
+
+class CNFProvenance;
+class BinaryGrammar;
+
 class CFG {
 private:
   string startSymbol;
-    int postUnitProdCount;
-    int postUselessProdCount;
-
-    void eliminateEpsilonProductions();
-    void eliminateUnitProductions();
-    void removeUselessSymbols();
-    void replaceTerminalsInBadBodies();
-    void breakLongBodies();
+  shared_ptr<const CNFProvenance> cnfProvenance;
 
-    void generateParsePaths(const string &current, const string &target, vector<string> &paths, string path);
+  void readBinary(const BinaryGrammar &binary);
 
 public:
+    // Reads the JSON schema (Variables/Terminals/Productions/Start) or
+    // a .cfgb file made by BinaryGrammar::write, told apart by content
     CFG(string Filename);
 
     void print();
-    void toCNF(); // Voegt de CNF-conversiemethode toe
+    // Converts the grammar to Chomsky normal form (without ε). Silent
+    // unless verbose, which prints the grammar before and after plus
+    // the statistics of every stage.
+    CNFReport toCNF(bool verbose = false);
+    // Where the productions made by the last toCNF come from (maps CNF
+    // derivations back to the grammar before it), nullptr before toCNF
+    const CNFProvenance *getCNFProvenance() const;
 
+    // Prints the verdict and a few derivations, true if there is more than one tree
     bool isAmbiguous(const string &testString);
+    // Counts the parse trees of testString in polynomial time (Earley
+    // forest + saturating counts) and collects up to `samples` derivations
+    AmbiguityReport checkAmbiguity(const string &testString, size_t samples = 0) const;
 
     void setStartSymbol(const string &symbol);
 
-    const map<string, vector<string>>& getProductionRules() const;
+    // Content hash of the grammar (symbols, productions in order, start
+    // symbol). Stable across runs and platforms; equal grammars compile
+    // to equal tables, which is what GrammarCache relies on.
+    uint64_t fingerprint() const;
+
+    // Every body is its list of symbols; an empty list is ε
+    const map<string, vector<vector<string>>>& getProductionRules() const;
     const set<string>& getNonTerminals() const;
     const set<char>& getTerminals() const;
     const string& getStartSymbol() const;
 
 
 
+
     set<string> nonTerminals;
     set<char> terminals;
-    map<string, vector<string>> productionRules;
+    map<string, vector<vector<string>>> productionRules;
 };
 
 #endif //PROGRAMEEROPDRACHT1_CFG_H
\ No newline at end of file
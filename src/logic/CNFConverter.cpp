@@ -0,0 +1,642 @@
+#include "CNFConverter.h"
+#include "BitKernels.h"
+#include "ParseForest.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Hash of a symbol sequence, used to dedupe (head, body...) keys
+struct SymbolsHash {
+  size_t operator()(const std::vector<SymbolId> &symbols) const {
+    uint64_t h = 1469598103934665603ull;
+    for (SymbolId s : symbols) {
+      h ^= (uint32_t)s;
+      h *= 1099511628211ull;
+    }
+    return (size_t)h;
+  }
+};
+using ProductionSet = std::unordered_set<std::vector<SymbolId>, SymbolsHash>;
+
+// CSR index: symbol -> production numbers, one entry per occurrence
+struct SymbolIndex {
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> entries;
+
+  IdRange<uint32_t> operator[](SymbolId s) const {
+    return { entries.data() + offsets[s], entries.data() + offsets[s + 1] };
+  }
+};
+
+// key(p) yields the symbols production p is filed under
+template <typename Keys>
+SymbolIndex buildIndex(size_t symbols, size_t count, Keys &&keys) {
+  SymbolIndex index;
+  index.offsets.assign(symbols + 1, 0);
+  for (size_t p = 0; p < count; p++) {
+    keys(p, [&](SymbolId s) { index.offsets[s + 1]++; });
+  }
+  for (size_t s = 1; s <= symbols; s++) index.offsets[s] += index.offsets[s - 1];
+  index.entries.resize(index.offsets[symbols]);
+  std::vector<uint32_t> fill(index.offsets.begin(), index.offsets.end() - 1);
+  for (size_t p = 0; p < count; p++) {
+    keys(p, [&](SymbolId s) { index.entries[fill[s]++] = (uint32_t)p; });
+  }
+  return index;
+}
+
+// outer with its first hole replaced by inner
+std::vector<int32_t> fillHole(const std::vector<int32_t> &outer, const std::vector<int32_t> &inner) {
+  auto hole = std::find(outer.begin(), outer.end(), CNFProvenance::Hole);
+  std::vector<int32_t> out(outer.begin(), hole);
+  out.insert(out.end(), inner.begin(), inner.end());
+  if (hole != outer.end()) out.insert(out.end(), hole + 1, outer.end());
+  return out;
+}
+
+} // namespace
+
+/**************************************************
+ * Construction and symbols
+ **************************************************/
+
+CNFConverter::CNFConverter(const CFG &cfg) {
+  for (char t : cfg.getTerminals()) intern(std::string(1, t), true);
+  for (const auto &nt : cfg.getNonTerminals()) intern(nt, false);
+  for (const auto &rule : cfg.getProductionRules()) intern(rule.first, false);
+  start = intern(cfg.getStartSymbol(), false);
+
+  // An unknown body symbol becomes a nonterminal without productions
+  // (and is removed as useless later on). Production p starts out as
+  // original rule p + 1 with a hole per body symbol.
+  for (const auto &rule : cfg.getProductionRules()) {
+    SymbolId head = ids.at(rule.first);
+    for (const auto &body : rule.second) {
+      Production p{ head, {}, { (int32_t)productions.size() + 1 }, CNFProvenance::Original };
+      for (const auto &name : body) {
+        auto it = ids.find(name);
+        p.body.push_back(it != ids.end() ? it->second : intern(name, false));
+        p.fragment.push_back(CNFProvenance::Hole);
+      }
+      productions.push_back(std::move(p));
+    }
+  }
+  report.originalProductions = productions.size();
+  originals = productions;
+}
+
+SymbolId CNFConverter::intern(const std::string &name, bool isTerminal) {
+  auto it = ids.find(name);
+  if (it != ids.end()) return it->second;
+  SymbolId id = (SymbolId)names.size();
+  names.push_back(name);
+  terminal.push_back(isTerminal);
+  ids.emplace(name, id);
+  return id;
+}
+
+// base, base', base'', ... whichever is free first
+SymbolId CNFConverter::freshNonTerminal(const std::string &base) {
+  std::string name = base;
+  while (ids.count(name)) name += '\'';
+  return intern(name, false);
+}
+
+size_t CNFConverter::usedNonTerminals() const {
+  std::vector<uint8_t> used(names.size(), 0);
+  size_t count = 0;
+  auto mark = [&](SymbolId s) {
+    if (isNonTerminal(s) && !used[s]) { used[s] = 1; count++; }
+  };
+  for (const auto &p : productions) {
+    mark(p.head);
+    for (SymbolId s : p.body) mark(s);
+  }
+  return count;
+}
+
+/**************************************************
+ * Stages
+ **************************************************/
+
+CNFReport CNFConverter::run() {
+  // Binarizing first leaves at most two nullable symbols per body, so
+  // ε-elimination makes at most three productions out of each
+  breakLongBodies();
+  eliminateEpsilonProductions();
+  eliminateUnitProductions();
+  removeUselessSymbols();
+  replaceTerminalsInBadBodies();
+  report.finalProductions = productions.size();
+  report.finalVariables = usedNonTerminals();
+  return report;
+}
+
+void CNFConverter::breakLongBodies() {
+  // A -> X1 X2 ... Xk becomes A -> X1 H2, H2 -> X2 H3, ..., H(k-1) -> X(k-1) Xk
+  // where Hi stands for the suffix Xi ... Xk, and bodies ending the same
+  // way share those helpers. Binarizing from the left (helpers for the
+  // prefixes) is the mirror image; whichever needs fewer helpers is used.
+  size_t count = productions.size();
+  ProductionSet suffixes, prefixes;
+  for (size_t r = 0; r < count; r++) {
+    const std::vector<SymbolId> &body = productions[r].body;
+    size_t k = body.size();
+    if (k <= 2) continue;
+    report.brokenBodies++;
+    report.unsharedHelpers += k - 2;
+    for (size_t i = 1; i + 1 < k; i++) {
+      suffixes.emplace(body.begin() + i, body.end());
+      prefixes.emplace(body.begin(), body.begin() + (k - i));
+    }
+  }
+  bool fromLeft = prefixes.size() < suffixes.size();
+  report.sharedPrefixes = fromLeft;
+
+  std::unordered_map<std::vector<SymbolId>, SymbolId, SymbolsHash> helperOf;
+  std::unordered_map<SymbolId, int> numbers; // per head, last number used
+  std::vector<SymbolId> seq;                 // the body, reversed from the left
+  std::vector<SymbolId> chain;               // chain[i] = helper of seq[i..k)
+  auto suffixKey = [&](size_t i) { return std::vector<SymbolId>(seq.begin() + i, seq.end()); };
+  auto makePair = [&](SymbolId first, SymbolId rest) {
+    return fromLeft ? std::vector<SymbolId>{ rest, first } : std::vector<SymbolId>{ first, rest };
+  };
+  for (size_t r = 0; r < count; r++) {
+    if (productions[r].body.size() <= 2) continue;
+    seq = productions[r].body;
+    if (fromLeft) std::reverse(seq.begin(), seq.end());
+    size_t k = seq.size();
+    SymbolId head = productions[r].head;
+
+    // Helpers exist for every suffix of one that exists, so only the
+    // longer suffixes before the first shared one are new
+    chain.assign(k, NoSymbol);
+    size_t shared = k - 1;
+    for (size_t i = 1; i + 1 < k; i++) {
+      auto it = helperOf.find(suffixKey(i));
+      if (it != helperOf.end()) {
+        shared = i;
+        chain[i] = it->second;
+        break;
+      }
+    }
+    int &number = numbers.emplace(head, 1).first->second;
+    for (size_t i = 1; i < shared; i++) {
+      chain[i] = freshNonTerminal(names[head] + "_" + std::to_string(++number));
+      helperOf.emplace(suffixKey(i), chain[i]);
+      report.helperVariables++;
+    }
+
+    // Every pair gets a hole for each of its two symbols, so the
+    // helpers' holes nest into the original rule's fragment in order
+    auto rest = [&](size_t i) { return i + 2 == k ? seq[k - 1] : chain[i + 1]; };
+    std::vector<int32_t> pairHoles{ CNFProvenance::Hole, CNFProvenance::Hole };
+    productions[r].body = makePair(seq[0], rest(0));
+    productions[r].fragment = { productions[r].fragment[0], CNFProvenance::Hole, CNFProvenance::Hole };
+    for (size_t i = 1; i < shared; i++) {
+      productions.push_back(Production{ chain[i], makePair(seq[i], rest(i)), pairHoles, CNFProvenance::Helper });
+    }
+  }
+  report.afterBinarize = productions.size();
+}
+
+void CNFConverter::eliminateEpsilonProductions() {
+  // Nullable symbols: a production's counter is the number of body
+  // symbols not yet known to be nullable, its head is nullable at zero.
+  size_t symbols = names.size();
+  SymbolIndex occurs = buildIndex(symbols, productions.size(), [&](size_t p, auto &&add) {
+    for (SymbolId s : productions[p].body) add(s);
+  });
+  // nullableBy[A] is the production that made A nullable; its body
+  // symbols were all nullable before, so these productions form finite
+  // ε-derivations.
+  std::vector<uint8_t> nullable(symbols, 0);
+  std::vector<uint32_t> nullableBy(symbols, 0);
+  std::vector<uint32_t> remaining(productions.size());
+  std::vector<SymbolId> worklist;
+  for (size_t p = 0; p < productions.size(); p++) {
+    remaining[p] = (uint32_t)productions[p].body.size();
+    SymbolId head = productions[p].head;
+    if (remaining[p] == 0 && !nullable[head]) {
+      nullable[head] = 1;
+      nullableBy[head] = (uint32_t)p;
+      worklist.push_back(head);
+    }
+  }
+  while (!worklist.empty()) {
+    SymbolId s = worklist.back();
+    worklist.pop_back();
+    for (uint32_t p : occurs[s]) {
+      SymbolId head = productions[p].head;
+      if (--remaining[p] == 0 && !nullable[head]) {
+        nullable[head] = 1;
+        nullableBy[head] = p;
+        worklist.push_back(head);
+      }
+    }
+  }
+  for (SymbolId s = 0; s < (SymbolId)symbols; s++) {
+    if (nullable[s]) report.nullable.push_back(names[s]);
+  }
+  std::sort(report.nullable.begin(), report.nullable.end());
+  report.startNullable = nullable[start] != 0;
+
+  // The ε-derivation of a nullable symbol in pre-order, built on demand:
+  // the fragment of nullableBy with the holes filled in
+  std::vector<std::vector<int32_t>> epsilonTrees(symbols);
+  std::vector<uint8_t> built(symbols, 0);
+  auto appendEpsilonTree = [&](SymbolId s, std::vector<int32_t> &out, auto &&self) -> void {
+    if (!built[s]) {
+      const Production &by = productions[nullableBy[s]];
+      std::vector<int32_t> tree;
+      size_t i = 0;
+      for (int32_t token : by.fragment) {
+        if (token == CNFProvenance::Hole) {
+          self(by.body[i++], tree, self);
+        } else {
+          tree.push_back(token);
+        }
+      }
+      epsilonTrees[s] = std::move(tree);
+      built[s] = 1;
+    }
+    out.insert(out.end(), epsilonTrees[s].begin(), epsilonTrees[s].end());
+  };
+
+  // Every production with each subset of its nullable occurrences left
+  // out, except the empty body; bodies have at most two symbols here.
+  // The left out symbols' holes get their ε-derivations.
+  std::vector<Production> result;
+  ProductionSet seen;
+  std::vector<SymbolId> key;
+  for (const Production &p : productions) {
+    size_t k = p.body.size();
+    unsigned optional = 0;
+    for (size_t i = 0; i < k; i++) optional |= unsigned(nullable[p.body[i]]) << i;
+    for (unsigned mask = 0; mask < (1u << k); mask++) {
+      if (mask & ~optional) continue;
+      key.assign(1, p.head);
+      for (size_t i = 0; i < k; i++) {
+        if (!((mask >> i) & 1)) key.push_back(p.body[i]);
+      }
+      if (key.size() == 1 || !seen.insert(key).second) continue;
+      std::vector<int32_t> fragment;
+      size_t i = 0;
+      for (int32_t token : p.fragment) {
+        if (token != CNFProvenance::Hole) {
+          fragment.push_back(token);
+        } else if ((mask >> i++) & 1) {
+          appendEpsilonTree(p.body[i - 1], fragment, appendEpsilonTree);
+        } else {
+          fragment.push_back(CNFProvenance::Hole);
+        }
+      }
+      result.push_back(Production{ p.head, std::vector<SymbolId>(key.begin() + 1, key.end()),
+                                   std::move(fragment), p.origin });
+    }
+  }
+  productions = std::move(result);
+  report.afterEpsilon = productions.size();
+}
+
+void CNFConverter::eliminateUnitProductions() {
+  size_t symbols = names.size();
+  auto isUnit = [&](const Production &p) {
+    return p.body.size() == 1 && isNonTerminal(p.body[0]);
+  };
+
+  // The unit graph only has the nonterminals of some A -> B
+  std::vector<int32_t> unitIndex(symbols, -1);
+  std::vector<SymbolId> unitSymbols;
+  auto vertex = [&](SymbolId s) {
+    if (unitIndex[s] < 0) {
+      unitIndex[s] = (int32_t)unitSymbols.size();
+      unitSymbols.push_back(s);
+    }
+    return (size_t)unitIndex[s];
+  };
+  std::vector<std::pair<size_t, size_t>> edges;
+  std::vector<uint32_t> edgeProduction;
+  for (size_t r = 0; r < productions.size(); r++) {
+    const Production &p = productions[r];
+    if (!isUnit(p)) continue;
+    report.unitProductions++;
+    size_t from = vertex(p.head);
+    edges.emplace_back(from, vertex(p.body[0]));
+    edgeProduction.push_back((uint32_t)r);
+  }
+
+  // Transitive closure on bitset rows (Warshall): row A holds every B
+  // with A =>* B
+  size_t vertices = unitSymbols.size();
+  size_t words = bitWords(vertices);
+  std::vector<uint64_t> closure(vertices * words, 0);
+  for (size_t v = 0; v < vertices; v++) setBit(&closure[v * words], v);
+  for (const auto &e : edges) setBit(&closure[e.first * words], e.second);
+  for (size_t k = 0; k < vertices; k++) {
+    const uint64_t *through = &closure[k * words];
+    for (size_t v = 0; v < vertices; v++) {
+      if (v != k && testBit(&closure[v * words], k)) orWords(&closure[v * words], through, words);
+    }
+  }
+
+  // The closure says which B a variable A reaches, a BFS from A says
+  // through which unit productions: chain[v] is the fragment of the
+  // path A =>* v, with a hole where the production of v goes
+  SymbolIndex unitOut = buildIndex(vertices, edges.size(), [&](size_t e, auto &&add) {
+    add((SymbolId)edges[e].first);
+  });
+  std::vector<std::vector<int32_t>> chain(vertices);
+  std::vector<uint32_t> visited(vertices, 0);
+  std::vector<size_t> queue;
+  auto findChains = [&](size_t from, uint32_t stamp) {
+    queue.assign(1, from);
+    visited[from] = stamp;
+    chain[from].assign(1, CNFProvenance::Hole);
+    for (size_t q = 0; q < queue.size(); q++) {
+      size_t v = queue[q];
+      for (uint32_t e : unitOut[(SymbolId)v]) {
+        size_t w = edges[e].second;
+        if (visited[w] == stamp) continue;
+        visited[w] = stamp;
+        chain[w] = fillHole(chain[v], productions[edgeProduction[e]].fragment);
+        queue.push_back(w);
+      }
+    }
+  };
+
+  // A gets the non-unit productions of every B it reaches; they keep
+  // A's origin, since the chain's fragment starts with a production of A
+  SymbolIndex byHead = buildIndex(symbols, productions.size(), [&](size_t p, auto &&add) {
+    add(productions[p].head);
+  });
+  std::vector<CNFProvenance::Origin> originOf(symbols, CNFProvenance::Original);
+  for (const auto &p : productions) originOf[p.head] = p.origin;
+  std::vector<Production> result;
+  ProductionSet seen;
+  std::vector<SymbolId> key;
+  auto copyFrom = [&](SymbolId A, SymbolId B, const std::vector<int32_t> *via) {
+    for (uint32_t r : byHead[B]) {
+      const Production &p = productions[r];
+      if (isUnit(p)) continue;
+      key.assign(1, A);
+      key.insert(key.end(), p.body.begin(), p.body.end());
+      if (!seen.insert(key).second) continue;
+      result.push_back(Production{ A, p.body, via ? fillHole(*via, p.fragment) : p.fragment, originOf[A] });
+    }
+  };
+  uint32_t stamp = 0;
+  for (SymbolId A = 0; A < (SymbolId)symbols; A++) {
+    if (!isNonTerminal(A)) continue;
+    if (unitIndex[A] < 0) {
+      report.unitPairs++;
+      copyFrom(A, A, nullptr);
+      continue;
+    }
+    const uint64_t *reach = &closure[(size_t)unitIndex[A] * words];
+    findChains((size_t)unitIndex[A], ++stamp);
+    copyFrom(A, A, nullptr);
+    forEachBit(reach, words, [&](size_t v) {
+      report.unitPairs++;
+      if (unitSymbols[v] != A) copyFrom(A, unitSymbols[v], &chain[v]);
+    });
+  }
+  productions = std::move(result);
+  report.afterUnit = productions.size();
+}
+
+void CNFConverter::removeUselessSymbols() {
+  size_t symbols = names.size();
+  size_t usedBefore = usedNonTerminals();
+
+  // Generating: counter = nonterminal occurrences not yet generating
+  SymbolIndex occurs = buildIndex(symbols, productions.size(), [&](size_t p, auto &&add) {
+    for (SymbolId s : productions[p].body) {
+      if (isNonTerminal(s)) add(s);
+    }
+  });
+  std::vector<uint8_t> generating(symbols, 0);
+  std::vector<uint32_t> remaining(productions.size(), 0);
+  std::vector<SymbolId> worklist;
+  for (size_t p = 0; p < productions.size(); p++) {
+    for (SymbolId s : productions[p].body) remaining[p] += isNonTerminal(s);
+    SymbolId head = productions[p].head;
+    if (remaining[p] == 0 && !generating[head]) {
+      generating[head] = 1;
+      worklist.push_back(head);
+    }
+  }
+  while (!worklist.empty()) {
+    SymbolId s = worklist.back();
+    worklist.pop_back();
+    for (uint32_t p : occurs[s]) {
+      SymbolId head = productions[p].head;
+      if (--remaining[p] == 0 && !generating[head]) {
+        generating[head] = 1;
+        worklist.push_back(head);
+      }
+    }
+  }
+
+  // Reachable from the start symbol through productions of generating
+  // symbols only
+  SymbolIndex byHead = buildIndex(symbols, productions.size(), [&](size_t p, auto &&add) {
+    if (remaining[p] == 0) add(productions[p].head);
+  });
+  std::vector<uint8_t> reachable(symbols, 0);
+  if (generating[start]) {
+    reachable[start] = 1;
+    worklist.push_back(start);
+  }
+  while (!worklist.empty()) {
+    SymbolId s = worklist.back();
+    worklist.pop_back();
+    for (uint32_t p : byHead[s]) {
+      for (SymbolId b : productions[p].body) {
+        if (isNonTerminal(b) && !reachable[b]) {
+          reachable[b] = 1;
+          worklist.push_back(b);
+        }
+      }
+    }
+  }
+
+  std::vector<Production> result;
+  for (size_t p = 0; p < productions.size(); p++) {
+    if (remaining[p] == 0 && reachable[productions[p].head]) result.push_back(std::move(productions[p]));
+  }
+  productions = std::move(result);
+  report.removedVariables = usedBefore - usedNonTerminals();
+  report.afterUseless = productions.size();
+}
+
+void CNFConverter::replaceTerminalsInBadBodies() {
+  // A terminal a in a body of length >= 2 is replaced by a variable
+  // whose only production is X -> a: an existing one if the grammar has
+  // it, otherwise a new "_a"
+  std::vector<SymbolId> terminalVar(names.size(), NoSymbol);
+  std::vector<uint32_t> perHead(names.size(), 0);
+  for (const auto &p : productions) perHead[p.head]++;
+  for (const auto &p : productions) {
+    if (p.body.size() == 1 && terminal[p.body[0]] && perHead[p.head] == 1 &&
+        terminalVar[p.body[0]] == NoSymbol) {
+      terminalVar[p.body[0]] = p.head;
+    }
+  }
+
+  size_t count = productions.size();
+  for (size_t r = 0; r < count; r++) {
+    if (productions[r].body.size() < 2) continue;
+    for (size_t i = 0; i < productions[r].body.size(); i++) {
+      SymbolId t = productions[r].body[i];
+      if (!terminal[t]) continue;
+      if (terminalVar[t] == NoSymbol) {
+        SymbolId var = freshNonTerminal("_" + names[t]);
+        terminalVar[t] = var;
+        report.terminalVariables.push_back(names[var]);
+        productions.push_back(Production{ var, { t }, {}, CNFProvenance::TerminalVariable });
+      }
+      productions[r].body[i] = terminalVar[t];
+      // the i-th hole of the fragment now holds a stand-in
+      size_t hole = 0;
+      for (int32_t &token : productions[r].fragment) {
+        if (token < 0 && hole++ == i) {
+          token = CNFProvenance::StandIn;
+          break;
+        }
+      }
+    }
+  }
+  report.afterTerminals = productions.size();
+}
+
+/**************************************************
+ * Result
+ **************************************************/
+
+void CNFConverter::writeTo(CFG &cfg) const {
+  cfg.productionRules.clear();
+  cfg.nonTerminals.clear();
+  for (const auto &p : productions) {
+    std::vector<std::string> body;
+    for (SymbolId s : p.body) {
+      body.push_back(names[s]);
+      if (isNonTerminal(s)) cfg.nonTerminals.insert(names[s]);
+    }
+    cfg.nonTerminals.insert(names[p.head]);
+    cfg.productionRules[names[p.head]].push_back(body);
+  }
+}
+
+std::shared_ptr<const CNFProvenance> CNFConverter::provenance() const {
+  auto result = std::make_shared<CNFProvenance>();
+  auto addRule = [&](CNFProvenance::Origin origin, uint8_t children, const std::vector<int32_t> &fragment) {
+    if (result->fragmentOffsets.empty()) result->fragmentOffsets.push_back(0);
+    result->origins.push_back(origin);
+    result->arity.push_back(children);
+    result->fragmentTokens.insert(result->fragmentTokens.end(), fragment.begin(), fragment.end());
+    result->fragmentOffsets.push_back((uint32_t)result->fragmentTokens.size());
+  };
+
+  // GrammarIndex numbers the rules by head name, then in body order,
+  // after rule 0 = S' -> S (which maps to itself)
+  addRule(CNFProvenance::Original, 1, { 0, CNFProvenance::Hole });
+  std::vector<uint32_t> order(productions.size());
+  for (size_t p = 0; p < order.size(); p++) order[p] = (uint32_t)p;
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return names[productions[a].head] < names[productions[b].head];
+  });
+  for (uint32_t p : order) {
+    const Production &prod = productions[p];
+    uint8_t children = 0;
+    for (SymbolId s : prod.body) children += isNonTerminal(s);
+    addRule(prod.origin, children, prod.fragment);
+  }
+
+  result->originalRules.push_back(names[start] + "' -> " + names[start]);
+  for (const auto &p : originals) {
+    std::string rule = names[p.head] + " -> ";
+    for (SymbolId s : p.body) rule += names[s];
+    if (p.body.empty()) rule += "ε";
+    result->originalRules.push_back(rule);
+  }
+  return result;
+}
+
+/**************************************************
+ * Provenance
+ **************************************************/
+
+struct CNFProvenance::Walk {
+  const std::vector<int> &derivation;
+  std::vector<size_t> end;  // one past the last rule of each node's subtree
+  std::vector<int> out;
+};
+
+IdRange<int32_t> CNFProvenance::fragment(int rule) const {
+  return { fragmentTokens.data() + fragmentOffsets[rule], fragmentTokens.data() + fragmentOffsets[rule + 1] };
+}
+
+std::vector<int> CNFProvenance::toOriginal(const std::vector<int> &derivation) const {
+  size_t n = derivation.size();
+  if (n == 0) return {};
+
+  // The rules of a leftmost derivation are the tree in pre-order, so the
+  // subtree extents follow from the arities, right to left
+  Walk walk{ derivation, std::vector<size_t>(n), {} };
+  for (size_t i = n; i-- > 0;) {
+    int rule = derivation[i];
+    if (rule < 0 || (size_t)rule >= origins.size()) {
+      throw std::runtime_error("CNF provenance: unknown rule " + std::to_string(rule));
+    }
+    size_t next = i + 1;
+    for (uint8_t c = 0; c < arity[rule]; c++) {
+      if (next >= n) throw std::runtime_error("CNF provenance: derivation ends inside a tree");
+      next = walk.end[next];
+    }
+    walk.end[i] = next;
+  }
+  if (walk.end[0] != n) throw std::runtime_error("CNF provenance: derivation has rules after its tree");
+  if (origins[derivation[0]] != Original) {
+    throw std::runtime_error("CNF provenance: derivation starts with helper rule " + std::to_string(derivation[0]));
+  }
+
+  emit(walk, 0);
+  return std::move(walk.out);
+}
+
+// A helper's fragment has no rule of its own, only the pieces of its
+// parent's body it stands for, so it is emitted in its parent's place
+void CNFProvenance::emit(Walk &walk, size_t node) const {
+  int rule = walk.derivation[node];
+  if (origins[rule] == TerminalVariable) {
+    throw std::runtime_error("CNF provenance: rule " + std::to_string(rule) +
+                             " is used outside the body it was made for");
+  }
+  size_t child = node + 1;
+  uint8_t left = arity[rule];
+  for (int32_t token : fragment(rule)) {
+    if (token >= 0) {
+      walk.out.push_back(token);
+      continue;
+    }
+    if (token == Hole && arity[rule] == 0) continue;  // the terminal of A -> a
+    if (left-- == 0) {
+      throw std::runtime_error("CNF provenance: rule " + std::to_string(rule) + " has too few children");
+    }
+    if (token == Hole) emit(walk, child);
+    child = walk.end[child];
+  }
+}
+
+std::vector<std::vector<int>> CNFProvenance::toOriginal(const ParseForest &forest, const GrammarIndex &grammar,
+                                                        size_t limit) const {
+  std::vector<std::vector<int>> result;
+  std::set<std::vector<int>> seen;
+  for (const auto &derivation : forest.sampleDerivations(limit, grammar)) {
+    std::vector<int> mapped = toOriginal(derivation);
+    if (seen.insert(mapped).second) result.push_back(std::move(mapped));
+  }
+  return result;
+}
@@ -0,0 +1,139 @@
+/**************************************************
+* CNFConverter.h - Chomsky normal form conversion on integer symbols
+*
+* Usage (CFG::toCNF does exactly this):
+*   CNFConverter converter(cfg);
+*   CNFReport report = converter.run();
+*   converter.writeTo(cfg);
+*
+* The stages are the textbook ones in the order BIN, DEL, UNIT
+* (binarization first, so ε-elimination makes at most three productions
+* per body), then useless symbols and terminals out of long bodies.
+* They run on integer-coded productions with worklist fixpoints:
+*   - nullable and generating symbols: one counter per production,
+*     decremented through a symbol -> productions index
+*   - unit pairs: transitive closure of the unit graph on bitset rows
+* Nothing is printed; CNFReport::print renders the statistics.
+*
+* Like the original conversion the result generates L - {ε}: when
+* the start symbol is nullable, report.startNullable says so.
+*
+* Every production of the result remembers where it comes from
+* (CNFProvenance), so a parse with the CNF grammar can be turned back
+* into a derivation of the original grammar:
+*   cfg.toCNF();
+*   EarleyParser parser(cfg);
+*   parser.setBuildForest(true);
+*   if (parser.parse(input)) {
+*     auto derivations = cfg.getCNFProvenance()->toOriginal(
+*         parser.getForest(), parser.getGrammar(), 10);
+*   }
+**************************************************/
+
+#ifndef CNFCONVERTER_H
+#define CNFCONVERTER_H
+
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "CFG.h"
+#include "GrammarIndex.h"
+
+class ParseForest;
+
+// Where the productions of a converted grammar come from. Rule ids are
+// GrammarIndex rule ids: of GrammarIndex(cfg) after toCNF for converted
+// rules, of GrammarIndex on the grammar before toCNF for original ones.
+class CNFProvenance {
+public:
+ enum Origin : uint8_t {
+   Original,          // stands for a piece of an original derivation
+   Helper,            // A_N -> XY from breaking a long body; stands for part of its parent
+   TerminalVariable   // _a -> a; only ever stands in for the terminal a
+ };
+
+ // Fragment tokens besides original rule ids (which are >= 0)
+ static constexpr int32_t Hole = -1;     // the next child (or the terminal of A -> a)
+ static constexpr int32_t StandIn = -2;  // the next child only stands for a terminal
+
+ size_t ruleCount() const { return origins.size(); }
+ Origin origin(int rule) const { return (Origin)origins[rule]; }
+ // The original derivation an Original rule stands for, in pre-order:
+ // eliminated ε and unit steps are there as original rules, the holes
+ // are the rule's children, left to right. A Helper rule's fragment is
+ // the same without the root: the subtrees of the body part it covers.
+ IdRange<int32_t> fragment(int rule) const;
+
+ size_t originalRuleCount() const { return originalRules.size(); }
+ // e.g. "A -> aB", "A -> ε"
+ const std::string &originalRule(int rule) const { return originalRules[rule]; }
+
+ // Maps a leftmost derivation in the converted grammar (the rule ids
+ // in pre-order, as ParseForest::sampleDerivations returns them) to a
+ // leftmost derivation of the same string in the original grammar
+ std::vector<int> toOriginal(const std::vector<int> &derivation) const;
+ // The same for up to `limit` trees of a forest over the converted
+ // grammar; trees that map to the same derivation are reported once
+ std::vector<std::vector<int>> toOriginal(const ParseForest &forest, const GrammarIndex &grammar,
+                                          size_t limit) const;
+
+private:
+ friend class CNFConverter;
+
+ std::vector<uint8_t> origins;          // per converted rule
+ std::vector<uint8_t> arity;            // nonterminal children per converted rule
+ std::vector<uint32_t> fragmentOffsets; // CSR over fragmentTokens
+ std::vector<int32_t> fragmentTokens;
+ std::vector<std::string> originalRules;
+
+ struct Walk;
+ void emit(Walk &walk, size_t node) const;
+};
+
+class CNFConverter {
+public:
+ explicit CNFConverter(const CFG &cfg);
+
+ // Runs all stages
+ CNFReport run();
+
+ // Replaces the nonterminals and productions of cfg with the result
+ void writeTo(CFG &cfg) const;
+ // Provenance of the rules writeTo produces
+ std::shared_ptr<const CNFProvenance> provenance() const;
+
+private:
+ struct Production {
+   SymbolId head;
+   std::vector<SymbolId> body;
+   std::vector<int32_t> fragment;  // see CNFProvenance::fragment
+   CNFProvenance::Origin origin = CNFProvenance::Original;
+ };
+
+ std::vector<std::string> names;
+ std::vector<uint8_t> terminal;        // per symbol
+ std::unordered_map<std::string, SymbolId> ids;
+ SymbolId start = NoSymbol;
+ std::vector<Production> productions;
+ std::vector<Production> originals;    // as read, for rendering provenance
+ CNFReport report;
+
+ SymbolId intern(const std::string &name, bool isTerminal);
+ SymbolId freshNonTerminal(const std::string &base);
+
+ bool isNonTerminal(SymbolId s) const { return !terminal[s]; }
+ size_t usedNonTerminals() const;
+
+ // Stages, in the order run() calls them
+ void breakLongBodies();
+ void eliminateEpsilonProductions();
+ void eliminateUnitProductions();
+ void removeUselessSymbols();
+ void replaceTerminalsInBadBodies();
+};
+
+#endif // CNFCONVERTER_H
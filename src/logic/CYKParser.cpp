@@ -0,0 +1,260 @@
+#include "CYKParser.h"
+#include "BitKernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+/**************************************************
+ * CNF rules
+ **************************************************/
+
+CNFRules splitCNFRules(const GrammarIndex &grammar) {
+  CNFRules rules;
+  for (int r = 1; r < (int)grammar.ruleCount(); r++) {
+    IdRange<SymbolId> body = grammar.ruleBody(r);
+    SymbolId head = grammar.ruleHead(r);
+    if (body.size() == 1 && grammar.isTerminal(body[0])) {
+      rules.terminalRules.emplace_back(head, body[0]);
+    } else if (body.size() == 2 && grammar.isNonTerminal(body[0]) && grammar.isNonTerminal(body[1])) {
+      rules.binaryRules.push_back(CNFRules::Binary{ head, body[0], body[1] });
+    } else if (body.empty() && head == grammar.startSymbol()) {
+      rules.acceptsEmpty = true;
+    } else {
+      throw std::runtime_error("CNF grammar: rule " + grammar.ruleToString(r) +
+                               " is not in Chomsky normal form");
+    }
+  }
+  return rules;
+}
+
+/**************************************************
+ * Construction
+ **************************************************/
+
+CYKParser::CYKParser(const CFG &cfg) : grammar(cfg) {
+  words = bitWords(grammar.nonTerminalCount());
+  buildMasks();
+}
+
+void CYKParser::buildMasks() {
+  size_t ntCount = grammar.nonTerminalCount();
+  terminalMasks.assign(grammar.terminalCount() * words, 0);
+  rightMasks.assign(ntCount * words, 0);
+  leftMask.assign(words, 0);
+
+  std::vector<std::pair<size_t, size_t>> pairs;    // (B, C) of every A -> BC
+  std::vector<size_t> pairHeads;
+  CNFRules rules = splitCNFRules(grammar);
+  acceptsEmpty = rules.acceptsEmpty;
+  for (const auto &rule : rules.terminalRules) {
+    setBit(&terminalMasks[rule.second * words], grammar.nonTerminalIndex(rule.first));
+  }
+  for (const auto &rule : rules.binaryRules) {
+    size_t B = grammar.nonTerminalIndex(rule.left);
+    size_t C = grammar.nonTerminalIndex(rule.right);
+    setBit(&rightMasks[B * words], C);
+    setBit(leftMask.data(), B);
+    pairs.emplace_back(B, C);
+    pairHeads.push_back(grammar.nonTerminalIndex(rule.head));
+  }
+
+  // Rank tables: the pairs of B are numbered by C, starting at pairStart[B]
+  rankBase.assign(ntCount * words, 0);
+  pairStart.assign(ntCount + 1, 0);
+  uint32_t total = 0;
+  for (size_t B = 0; B < ntCount; B++) {
+    pairStart[B] = total;
+    uint32_t rank = 0;
+    for (size_t w = 0; w < words; w++) {
+      rankBase[B * words + w] = rank;
+      rank += (uint32_t)__builtin_popcountll(rightMasks[B * words + w]);
+    }
+    total += rank;
+  }
+  pairStart[ntCount] = total;
+
+  // Head sets; several rules may share (B, C)
+  headMasks.assign((size_t)total * words, 0);
+  for (size_t p = 0; p < pairs.size(); p++) {
+    size_t B = pairs[p].first, C = pairs[p].second;
+    size_t w = C >> 6;
+    uint64_t below = rightMasks[B * words + w] & ((uint64_t(1) << (C & 63)) - 1);
+    size_t slot = pairStart[B] + rankBase[B * words + w] + (size_t)__builtin_popcountll(below);
+    setBit(&headMasks[slot * words], pairHeads[p]);
+  }
+  if (words == 1) {
+    pairTable.assign(64 * 64, 0);
+    for (size_t p = 0; p < pairs.size(); p++) {
+      setBit(&pairTable[pairs[p].first * 64 + pairs[p].second], pairHeads[p]);
+    }
+  }
+}
+
+/**************************************************
+ * Parsing
+ **************************************************/
+
+// out |= heads of every A -> BC with B in left and C in right
+void CYKParser::combine(uint64_t *out, const uint64_t *left, const uint64_t *right, uint64_t *hits) const {
+  for (size_t lw = 0; lw < words; lw++) {
+    uint64_t candidates = left[lw] & leftMask[lw];
+    while (candidates) {
+      size_t B = lw * 64 + (size_t)__builtin_ctzll(candidates);
+      candidates &= candidates - 1;
+
+      const uint64_t *rights = &rightMasks[B * words];
+      if (!andWords(hits, right, rights, words)) continue;
+      const uint32_t *ranks = &rankBase[B * words];
+      for (size_t w = 0; w < words; w++) {
+        uint64_t word = hits[w];
+        while (word) {
+          uint64_t bit = word & (~word + 1);
+          word ^= bit;
+          size_t slot = pairStart[B] + ranks[w] + (size_t)__builtin_popcountll(rights[w] & (bit - 1));
+          orWords(out, &headMasks[slot * words], words);
+        }
+      }
+    }
+  }
+}
+
+// Same for grammars with at most 64 nonterminals
+uint64_t CYKParser::combineWord(uint64_t left, uint64_t right) const {
+  uint64_t out = 0;
+  uint64_t candidates = left & leftMask[0];
+  while (candidates) {
+    size_t B = (size_t)__builtin_ctzll(candidates);
+    candidates &= candidates - 1;
+
+    uint64_t word = right & rightMasks[B];
+    const uint64_t *heads = &pairTable[B * 64];
+    while (word) {
+      out |= heads[__builtin_ctzll(word)];
+      word &= word - 1;
+    }
+  }
+  return out;
+}
+
+bool CYKParser::parse(const std::string &input) {
+  length = input.size();
+  accepted = false;
+  if (length == 0) {
+    byStart.clear();
+    byEnd.clear();
+    startLive.clear();
+    endLive.clear();
+    accepted = acceptsEmpty;
+    return accepted;
+  }
+
+  size_t cells = length * (length + 1) / 2;
+  byStart.assign(cells * words, 0);
+  byEnd.assign(cells * words, 0);
+  startLive.assign(cells, 0);
+  endLive.assign(cells, 0);
+
+  // Spans of length 1: A -> a
+  for (size_t i = 0; i < length; i++) {
+    SymbolId t = grammar.terminalFor(input[i]);
+    if (t == NoSymbol) continue;
+    const uint64_t *mask = &terminalMasks[t * words];
+    std::copy(mask, mask + words, &byStart[startCell(i, 1) * words]);
+    std::copy(mask, mask + words, &byEnd[endCell(i + 1, 1) * words]);
+    startLive[startCell(i, 1)] = endLive[endCell(i + 1, 1)] = anyWords(mask, words);
+  }
+
+  // Longer spans, tile diagonal by tile diagonal
+  size_t threads = pool ? pool->size() + 1 : 1;
+  size_t tile = tileSize ? tileSize : chooseTileSize(threads);
+  size_t tiles = (length + tile - 1) / tile;
+  scratch.assign(threads * 2 * words, 0);
+  for (size_t d = 0; d < tiles; d++) {
+    size_t count = tiles - d;
+    if (pool && count > 1) {
+      pool->parallelFor(count, [&](size_t t, size_t worker) {
+        fillTile(t, t + d, tile, &scratch[worker * 2 * words]);
+      });
+    } else {
+      for (size_t t = 0; t < count; t++) fillTile(t, t + d, tile, scratch.data());
+    }
+  }
+
+  accepted = derives(grammar.startSymbol(), 0, length);
+  return accepted;
+}
+
+// Cell (i, i+len). For [i, i+len) split after k symbols: the left
+// part is byStart row i at length k, the right part is byEnd row i+len
+// at length len-k, so both are walked in order.
+void CYKParser::fillCell(size_t i, size_t len, uint64_t *work) {
+  const uint64_t *leftRow = &byStart[startCell(i, 1) * words];
+  const uint64_t *rightRow = &byEnd[endCell(i + len, 1) * words];
+  const uint8_t *leftLive = &startLive[startCell(i, 1)];
+  const uint8_t *rightLive = &endLive[endCell(i + len, 1)];
+
+  if (words == 1) {
+    uint64_t result = 0;
+    for (size_t k = 1; k < len; k++) {
+      result |= combineWord(leftRow[k - 1], rightRow[len - k - 1]);
+    }
+    if (!result) return;
+    byStart[startCell(i, len)] = byEnd[endCell(i + len, len)] = result;
+  } else {
+    uint64_t *cellSet = work;
+    std::fill(cellSet, cellSet + words, 0);
+    for (size_t k = 1; k < len; k++) {
+      if (!leftLive[k - 1] || !rightLive[len - k - 1]) continue;
+      combine(cellSet, leftRow + (k - 1) * words, rightRow + (len - k - 1) * words, work + words);
+    }
+    if (!anyWords(cellSet, words)) return;
+    std::copy(cellSet, cellSet + words, &byStart[startCell(i, len) * words]);
+    std::copy(cellSet, cellSet + words, &byEnd[endCell(i + len, len) * words]);
+  }
+  startLive[startCell(i, len)] = endLive[endCell(i + len, len)] = 1;
+}
+
+// Tile (r, c) holds the spans [i, e+1) with i in tile row r and the
+// last symbol e in tile column c. A span only needs shorter spans with
+// the same start (tiles left of it) or the same end (tiles below it),
+// so a tile can be filled by increasing length once the earlier tile
+// diagonals are done. All spans of one start stay in one tile row,
+// which keeps that row of the table in cache while the tile is filled.
+void CYKParser::fillTile(size_t tileRow, size_t tileColumn, size_t tile, uint64_t *work) {
+  size_t rowFirst = tileRow * tile, rowLast = std::min(rowFirst + tile, length);
+  size_t colFirst = tileColumn * tile, colLast = std::min(colFirst + tile, length);
+  size_t maxLen = colLast - rowFirst;
+  for (size_t len = 2; len <= maxLen; len++) {
+    // e = i + len - 1 must lie in [colFirst, colLast)
+    size_t first = colFirst + 1 >= len ? std::max(rowFirst, colFirst + 1 - len) : rowFirst;
+    size_t last = std::min(rowLast, colLast + 1 - len);
+    for (size_t i = first; i < last; i++) {
+      fillCell(i, len, work);
+    }
+  }
+}
+
+// Small enough for a few tiles per worker on every diagonal but the
+// last ones, large enough to reuse the rows it loads
+size_t CYKParser::chooseTileSize(size_t threads) const {
+  if (threads <= 1) return 64;
+  size_t tile = length / (4 * threads);
+  return std::max<size_t>(16, std::min<size_t>(64, tile));
+}
+
+/**************************************************
+ * Table queries
+ **************************************************/
+
+bool CYKParser::derives(SymbolId nt, size_t start, size_t len) const {
+  if (len == 0 || start + len > length || !grammar.isNonTerminal(nt)) return false;
+  return testBit(cell(start, len).begin(), grammar.nonTerminalIndex(nt));
+}
+
+std::vector<SymbolId> CYKParser::spanSymbols(size_t start, size_t len) const {
+  std::vector<SymbolId> result;
+  if (len == 0 || start + len > length) return result;
+  forEachBit(cell(start, len).begin(), words, [&](size_t idx) {
+    result.push_back(grammar.nonTerminalAt(idx));
+  });
+  return result;
+}
@@ -0,0 +1,131 @@
+/**************************************************
+* CYKParser.h - Bit-parallel CYK recognizer for CNF grammars
+*
+* Usage:
+*   CFG cfg("grammar.json");
+*   cfg.toCNF();
+*   CYKParser parser(cfg);
+*   bool ok = parser.parse("abba");
+*   parser.spanSymbols(1, 2);   // nonterminals deriving "bb"
+*
+* The grammar must be in Chomsky normal form: A -> BC, A -> a,
+* and optionally S -> ε for the start symbol (which only makes
+* the empty input accepted). Anything else is rejected with a
+* runtime_error by the constructor.
+*
+* Each table cell is a bitset over the nonterminals (bit =
+* GrammarIndex::nonTerminalIndex). Combining two cells walks the
+* left children present in the left cell and picks their rules with
+* one AND of precomputed masks per left child, see BitKernels.h.
+*
+* The table is filled in square tiles of (start, end) positions.
+* Tiles on the same tile diagonal do not depend on each other, so
+* with a ThreadPool attached each diagonal is spread over the pool.
+**************************************************/
+
+#ifndef CYKPARSER_H
+#define CYKPARSER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+
+#include "CFG.h"
+#include "GrammarIndex.h"
+
+class ThreadPool;
+
+// The rules of a CNF grammar by shape, shared by the CNF recognizers
+struct CNFRules {
+ struct Binary {
+   SymbolId head, left, right; // head -> left right
+ };
+ std::vector<std::pair<SymbolId, SymbolId>> terminalRules; // (A, a) for A -> a
+ std::vector<Binary> binaryRules;
+ bool acceptsEmpty = false;                                // S -> ε
+};
+
+// Sorts the rules of `grammar` (except the augmented rule 0) by shape,
+// throws runtime_error for a rule that is not in Chomsky normal form
+CNFRules splitCNFRules(const GrammarIndex &grammar);
+
+class CYKParser {
+public:
+ explicit CYKParser(const CFG &cfg);
+
+ // Fills the table for `input`, true if the start symbol derives it
+ bool parse(const std::string &input);
+ bool isAccepted() const { return accepted; }
+
+ // ---- The table of the last parse ----
+ size_t inputLength() const { return length; }
+ size_t wordsPerCell() const { return words; }
+ // Nonterminals deriving input[start, start + len), 1 <= len
+ IdRange<uint64_t> cell(size_t start, size_t len) const {
+   const uint64_t *c = byStart.data() + startCell(start, len) * words;
+   return { c, c + words };
+ }
+ bool derives(SymbolId nt, size_t start, size_t len) const;
+ std::vector<SymbolId> spanSymbols(size_t start, size_t len) const;
+
+ const GrammarIndex &getGrammar() const { return grammar; }
+
+ // Fill the table on `workers` (nullptr = on the calling thread, the
+ // default). The pool must outlive the parses that use it.
+ void setThreadPool(ThreadPool *workers) { pool = workers; }
+ // Side of a tile in input positions, 0 (default) picks one from the
+ // input length and the number of workers
+ void setTileSize(size_t size) { tileSize = size; }
+
+private:
+ GrammarIndex grammar;
+ size_t words = 0;            // words per nonterminal bitset
+ bool acceptsEmpty = false;   // S -> ε
+
+ // Unit rules: nonterminals with A -> a, per terminal id
+ std::vector<uint64_t> terminalMasks;
+ // Binary rules, grouped by left child B. rightMasks[B] is the set of
+ // right children C that occur in some A -> BC; the head set of (B, C)
+ // is headMasks[pairStart[B] + rank of C in rightMasks[B]], where the
+ // rank is rankBase[B][w] + popcount of the lower bits in word w.
+ std::vector<uint64_t> rightMasks;   // nonterminal index * words
+ std::vector<uint32_t> rankBase;     // nonterminal index * words
+ std::vector<uint32_t> pairStart;    // per nonterminal index
+ std::vector<uint64_t> headMasks;    // pair * words
+ std::vector<uint64_t> leftMask;     // nonterminals that are a left child
+ // With at most 64 nonterminals (words == 1): heads of (B, C) at B * 64 + C
+ std::vector<uint64_t> pairTable;
+
+ // The triangular table, stored twice so that the split loop reads
+ // both operands sequentially: byStart has row i = spans starting at
+ // i by length, byEnd has row j = spans ending at j by length.
+ std::vector<uint64_t> byStart;
+ std::vector<uint64_t> byEnd;
+ std::vector<uint8_t> startLive;     // byStart cell is not empty
+ std::vector<uint8_t> endLive;       // byEnd cell is not empty
+ // Per worker: the cell being filled and the right children of one
+ // left child, `words` each
+ std::vector<uint64_t> scratch;
+ size_t length = 0;
+ bool accepted = false;
+
+ ThreadPool *pool = nullptr;
+ size_t tileSize = 0;
+
+ size_t startCell(size_t start, size_t len) const {
+   return start * (2 * length - start + 1) / 2 + (len - 1);
+ }
+ size_t endCell(size_t end, size_t len) const {
+   return end * (end - 1) / 2 + (len - 1);
+ }
+
+ void buildMasks();
+ void combine(uint64_t *out, const uint64_t *left, const uint64_t *right, uint64_t *hits) const;
+ uint64_t combineWord(uint64_t left, uint64_t right) const; // words == 1
+ void fillCell(size_t start, size_t len, uint64_t *work);
+ void fillTile(size_t tileRow, size_t tileColumn, size_t tile, uint64_t *work);
+ size_t chooseTileSize(size_t threads) const;
+};
+
+#endif // CYKPARSER_H
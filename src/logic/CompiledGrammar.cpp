@@ -0,0 +1,28 @@
+#include "CompiledGrammar.h"
+
+std::shared_ptr<const CompiledGrammar> CompiledGrammar::compile(const CFG &cfg) {
+  return std::make_shared<const CompiledGrammar>(cfg);
+}
+
+std::shared_ptr<const CompiledGrammar> CompiledGrammar::compile(const BinaryGrammar &binary) {
+  return std::make_shared<const CompiledGrammar>(binary);
+}
+
+CompiledGrammar::CompiledGrammar(const CFG &cfg) : grammar(cfg) {}
+
+CompiledGrammar::CompiledGrammar(const BinaryGrammar &binary) : grammar(binary) {}
+
+const LRTables &CompiledGrammar::lrTables(LRTableKind kind) const {
+  size_t k = kindSlot(kind);
+  std::call_once(lrBuilt[k], [&] {
+    lr[k].reset(new LRTables(LRTables::build(grammar, kind)));
+  });
+  return *lr[k];
+}
+
+void CompiledGrammar::provideLRTables(LRTables tables) const {
+  size_t k = kindSlot(tables.kind);
+  std::call_once(lrBuilt[k], [&] {
+    lr[k].reset(new LRTables(std::move(tables)));
+  });
+}
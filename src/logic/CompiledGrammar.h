@@ -0,0 +1,63 @@
+/**************************************************
+* CompiledGrammar.h - Immutable, shared analysis of one grammar
+*
+* Usage:
+*   std::shared_ptr<const CompiledGrammar> g = CompiledGrammar::compile(cfg);
+*   // any number of threads, one parser (or ParseSession) each:
+*   EarleyParser earley(g);
+*   GLRParser glr(g);
+*
+*   // or straight from a mapped .cfgb file, without a CFG in between
+*   auto g2 = CompiledGrammar::compile(*BinaryGrammar::open("grammar.cfgb"));
+*
+* Holds everything that depends only on the grammar: the GrammarIndex
+* (symbols, rules, nullable set) and the LR tables. Parsers keep a
+* reference-counted pointer to it plus their own per-parse state, so
+* a parser per thread costs no grammar analysis at all.
+*
+* Nothing changes after construction except that the LR tables of each
+* kind are built on first request (std::call_once), so Earley-only
+* users never pay for the automaton. Safe to share between threads.
+* It does not refer to the CFG or file it was compiled from.
+**************************************************/
+
+#ifndef COMPILEDGRAMMAR_H
+#define COMPILEDGRAMMAR_H
+
+#include <memory>
+#include <mutex>
+
+#include "BinaryGrammar.h"
+#include "CFG.h"
+#include "GrammarIndex.h"
+#include "LRTables.h"
+
+class CompiledGrammar {
+public:
+ static std::shared_ptr<const CompiledGrammar> compile(const CFG &cfg);
+ static std::shared_ptr<const CompiledGrammar> compile(const BinaryGrammar &binary);
+
+ explicit CompiledGrammar(const CFG &cfg);
+ explicit CompiledGrammar(const BinaryGrammar &binary);
+ CompiledGrammar(const CompiledGrammar &) = delete;
+ CompiledGrammar &operator=(const CompiledGrammar &) = delete;
+
+ const GrammarIndex &getGrammar() const { return grammar; }
+
+ // The automaton tables of `kind`, built by the first caller
+ const LRTables &lrTables(LRTableKind kind) const;
+
+private:
+ friend class GrammarCache;
+ // Installs tables loaded from elsewhere, unless they exist already
+ void provideLRTables(LRTables tables) const;
+ static size_t kindSlot(LRTableKind kind) { return kind == LRTableKind::LALR1 ? 0 : 1; }
+
+ GrammarIndex grammar;
+
+ static constexpr size_t TableKinds = 2;  // LALR1, LR1
+ mutable std::once_flag lrBuilt[TableKinds];
+ mutable std::unique_ptr<const LRTables> lr[TableKinds];
+};
+
+#endif // COMPILEDGRAMMAR_H
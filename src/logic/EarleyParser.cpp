@@ -6,10 +6,11 @@
  * Implementation
  **************************************************/
 
-EarleyParser::EarleyParser(const CFG &cfg) : cfg(cfg) {
-  startSymbol = cfg.getStartSymbol();
-  // Build an augmented symbol, e.g. "S'"
-  augmentedSymbol = startSymbol + "'";
+EarleyParser::EarleyParser(const CFG &cfg) : EarleyParser(CompiledGrammar::compile(cfg)) {
+}
+
+EarleyParser::EarleyParser(std::shared_ptr<const CompiledGrammar> compiledGrammar)
+    : compiled(std::move(compiledGrammar)), grammar(compiled->getGrammar()) {
 }
 
 // Full parse (no stepping)
@@ -26,26 +27,26 @@ void EarleyParser::reset(const std::string &input) {
   currentPos = 0;
   finished = false;
   accepted = false;
-  stepExplanations.clear();
 
-  // chart has length input.size() + 1
-  size_t length = currentInput.size();
-  chart.clear();
-  chart.resize(length + 1);
+  // chart has length input.size() + 1, columns are opened as we go
+  items.clear();
+  nextWaiting.clear();
+  columnStarts.clear();
+  waitingHeads.clear();
+  leoMemo.clear();
+  leoTops.clear();
+  forest.clear();
+  itemNodes.clear();
+  startColumn();
+
+  PARSER_TRACE(trace, TraceKind::EarleyReset, 0, 0, 0);
 
   // Insert the augmented item: S' -> • S, at chart[0]
-  // That is: head="S'", body=S, dotPos=0, startIdx=0
-  EarleyItem initial{augmentedSymbol, startSymbol, 0, 0};
-  chart[0].insert(initial);
+  // That is: rule 0, dot 0, origin 0
+  addItem(grammar.dotted(0, 0), 0);
 
   // Apply predict & complete to chart[0]
   predictAndComplete(0);
-
-  std::ostringstream msg;
-  msg << "EarleyParser reset: inserted augmented item "
-      << augmentedSymbol << " -> •" << startSymbol
-      << " at chart[0].";
-  stepExplanations.push_back(msg.str());
 }
 
 bool EarleyParser::nextStep() {
@@ -64,44 +65,106 @@ bool EarleyParser::nextStep() {
     // Move forward in the input
     currentPos++;
 
-    std::ostringstream msg;
-    msg << "Earley: advanced to pos=" << currentPos
-        << " (nextChar='" << nextChar << "').";
-    stepExplanations.push_back(msg.str());
+    PARSER_TRACE(trace, TraceKind::EarleyAdvance, 0, 0, (uint32_t)currentPos, (unsigned char)nextChar);
   }
   else {
     // We have reached the end of the input
     finished = true;
 
-    // Check if the augmented item was completed in chart[input.size()]
-    // That means an item: S' -> S • with startIdx=0 is present
-    for (auto &item : chart[currentInput.size()]) {
-      if (item.head == augmentedSymbol &&
-          item.dotPos == item.body.size() &&
-          item.startIdx == 0) {
-        accepted = true;
-        break;
+    // Check if the augmented item was completed in the last column
+    // That means an item: S' -> S • with origin=0 is present.
+    // (If a scan failed earlier, the last column was never opened.)
+    if (columnStarts.size() == currentInput.size() + 1) {
+      uint32_t done = grammar.dotted(0, grammar.ruleLength(0));
+      for (size_t i = columnStarts.back(); i < items.size(); i++) {
+        if (items[i].dottedRule == done && items[i].origin == 0) {
+          accepted = true;
+          if (buildForest) {
+            // S'(0,n) has the single family (S -> ...)(0,n)
+            forest.setRoot(forest.family(forest.node(itemNodes[i]).firstFamily).right);
+          }
+          break;
+        }
       }
     }
 
-    std::ostringstream msg;
-    msg << "Earley: end of input. "
-        << (accepted ? "ACCEPTED" : "REJECTED");
-    stepExplanations.push_back(msg.str());
+    PARSER_TRACE(trace, TraceKind::EarleyEnd, accepted, 0, (uint32_t)currentPos);
   }
 
   return !finished;
 }
 
-bool EarleyParser::isNonTerminal(const std::string &symbol) const {
-  // For single-character nonterminals, symbol.size()==1
-  // and symbol is in cfg.getNonTerminals().
-  return (cfg.getNonTerminals().count(symbol) > 0);
+EarleyChartView EarleyParser::getChart() const {
+  EarleyChartView view;
+  view.items = items.data();
+  view.columnStarts = columnStarts.data();
+  view.startedColumns = columnStarts.size();
+  view.itemCount = items.size();
+  view.columns = currentInput.size() + 1;
+  return view;
+}
+
+// Opens the next column: everything appended from now on belongs to it
+void EarleyParser::startColumn() {
+  columnStarts.push_back(items.size());
+  openColumn.clear();
+  symbolNodes.clear();
+  familySeen.clear();
+}
+
+// Appends an item to the open column unless it is already there.
+// When building the forest, `left`/`right` are the nodes this derivation
+// of the item was made from and `split` is where `right` starts.
+bool EarleyParser::addItem(uint32_t dottedRule, size_t origin,
+                           SPPFNodeId left, SPPFNodeId right, size_t split) {
+  EarleyItem item{dottedRule, (uint32_t)origin};
+  bool inserted;
+  uint32_t idx = openColumn.findOrInsert(item.key(), (uint32_t)items.size(), inserted);
+  if (inserted) {
+    items.push_back(item);
+    nextWaiting.push_back(UINT32_MAX);
+  }
+  if (!buildForest) return inserted;
+
+  // Forest node of the item (Scott's make_node):
+  //   A -> •β        no node
+  //   A -> x•β       the node of x itself
+  //   A -> αx•β      intermediate node (A -> αx•β, origin, here)
+  //   A -> γ•        symbol node (A, origin, here), shared by all rules of A
+  size_t dot = grammar.dottedDotOf(dottedRule);
+  bool completed = grammar.isCompleted(dottedRule);
+  if (inserted) {
+    SPPFNodeId node = NoNode;
+    uint32_t here = (uint32_t)(columnStarts.size() - 1);
+    if (completed) {
+      node = symbolNode(grammar.ruleHead(grammar.dottedRuleOf(dottedRule)), origin);
+    } else if (dot == 1) {
+      node = right;
+    } else if (dot > 1) {
+      node = forest.addNode(SPPFKind::Intermediate, (int32_t)dottedRule, (uint32_t)origin, here);
+    }
+    itemNodes.push_back(node);
+  }
+
+  // Record this derivation as a family of the node, once per split
+  if (completed || dot > 1) {
+    bool newFamily;
+    familySeen.findOrInsert((uint64_t(idx) << 32) | uint32_t(split), 0, newFamily);
+    if (newFamily) {
+      forest.addFamily(itemNodes[idx], dottedRule, left, right);
+    }
+  }
+  return inserted;
 }
 
-bool EarleyParser::isTerminal(char symbol) const {
-  // For single-character terminals, check if symbol is in the set.
-  return (cfg.getTerminals().count(symbol) > 0);
+// Shared symbol node (sym, start, open column)
+SPPFNodeId EarleyParser::symbolNode(SymbolId sym, size_t start) {
+  bool isNew;
+  uint32_t &node = symbolNodes.findOrInsert((uint64_t(sym) << 32) | uint32_t(start), NoNode, isNew);
+  if (isNew) {
+    node = forest.addNode(SPPFKind::Symbol, sym, (uint32_t)start, (uint32_t)(columnStarts.size() - 1));
+  }
+  return node;
 }
 
 /**************************************************
@@ -111,117 +174,188 @@ bool EarleyParser::isTerminal(char symbol) const {
  **************************************************/
 void EarleyParser::scan(char nextChar) {
   size_t pos = currentPos; // from chart[pos] to chart[pos+1]
+  // Characters that are not terminals of the grammar match nothing
+  SymbolId terminal = grammar.terminalFor(nextChar);
+
+  // chart[pos] is complete; everything appended now goes to chart[pos+1].
+  // We walk chart[pos] by index because appending may reallocate.
+  size_t begin = columnStarts[pos];
+  size_t end = items.size();
+  startColumn();
 
-  // We'll iterate over a snapshot of chart[pos]
-  // because we might insert new items into chart[pos+1].
-  std::vector<EarleyItem> items(chart[pos].begin(), chart[pos].end());
+  SPPFNodeId terminalNode = NoNode;
+  if (buildForest && terminal != NoSymbol) {
+    terminalNode = forest.addNode(SPPFKind::Terminal, terminal, (uint32_t)pos, (uint32_t)pos + 1);
+  }
 
   bool scannedAnything = false;
-  for (auto &item : items) {
-    // If dotPos not at end, check the next symbol
-    if (item.dotPos < item.body.size()) {
-      char sym = item.body[item.dotPos];
-      // If it's a terminal and matches nextChar, we can shift
-      if (isTerminal(sym) && sym == nextChar) {
-        // Move the dot one to the right
-        EarleyItem newItem = item;
-        newItem.dotPos++;
-        // Insert it into chart[pos+1]
-        chart[pos + 1].insert(newItem);
-        scannedAnything = true;
-      }
+  for (size_t i = begin; i < end; i++) {
+    EarleyItem item = items[i];
+    // If it's a terminal and matches nextChar, we can shift
+    // (a completed item has NoSymbol after the dot)
+    if (terminal != NoSymbol && grammar.symbolAfterDot(item.dottedRule) == terminal) {
+      // Moving the dot one to the right is the next dotted rule id
+      addItem(item.dottedRule + 1, item.origin,
+              buildForest ? itemNodes[i] : NoNode, terminalNode, pos);
+      scannedAnything = true;
     }
   }
 
-  std::ostringstream msg;
-  msg << "Earley: SCAN at pos=" << pos
-      << " with nextChar='" << nextChar << "'. ";
-  if (scannedAnything) {
-    msg << "Some items scanned -> chart[" << (pos+1) << "] updated.";
-  } else {
-    msg << "No items matched terminal '" << nextChar << "'.";
-  }
-  stepExplanations.push_back(msg.str());
+  PARSER_TRACE(trace, TraceKind::EarleyScan, scannedAnything, 0, (uint32_t)pos, (unsigned char)nextChar);
 }
 
 /**************************************************
  * PREDICT & COMPLETE
- * For each item in chart[pos],
+ * chart[pos] doubles as the agenda: every item is
+ * visited exactly once, in the order it was added.
  *   - If next symbol is a nonterminal, PREDICT
  *   - If dot is at end, COMPLETE
  **************************************************/
 void EarleyParser::predictAndComplete(size_t pos) {
-  bool changed = true;
-  while(changed) {
-    changed = false;
-
-    // We'll iterate over a snapshot of chart[pos] items
-    std::vector<EarleyItem> items(chart[pos].begin(), chart[pos].end());
-
-    for (auto &item : items) {
-      // If dot not at end, check next symbol
-      if (item.dotPos < item.body.size()) {
-        std::string sym(1, item.body[item.dotPos]);
-        // PREDICT if sym is a nonterminal
-        if (isNonTerminal(sym)) {
-          // For each rule X -> Y in the CFG,
-          // if X == sym, add an item X -> •Y in chart[pos].
-          // (startIdx = pos)
-          auto &prodMap = cfg.getProductionRules();
-          auto it = prodMap.find(sym);
-          if (it != prodMap.end()) {
-            for (auto &rhs : it->second) {
-              // build an item sym -> •rhs
-              EarleyItem newItem{sym, rhs, 0, pos};
-              auto ins = chart[pos].insert(newItem);
-              if (ins.second) {
-                changed = true;
-                std::ostringstream msg;
-                msg << "Earley: PREDICT at chart[" << pos << "]: "
-                    << newItem.head << " -> •" << newItem.body;
-                stepExplanations.push_back(msg.str());
-              }
-            }
-          }
-        }
+  // items.size() grows while we walk, so new items get their turn too
+  for (size_t i = columnStarts[pos]; i < items.size(); i++) {
+    SymbolId sym = grammar.symbolAfterDot(items[i].dottedRule);
+    if (sym == NoSymbol) {
+      complete(pos, i);
+    } else if (isNonTerminal(sym)) {
+      predict(pos, i, sym);
+    }
+  }
+}
+
+// items[itemIdx] waits on `sym`: register it, and predict sym's rules
+// the first time anyone in this column asks for sym.
+void EarleyParser::predict(size_t pos, size_t itemIdx, SymbolId sym) {
+  bool firstWaiter;
+  uint32_t &head = waitingHeads.findOrInsert((uint64_t(pos) << 32) | uint32_t(sym),
+                                             UINT32_MAX, firstWaiter);
+  nextWaiting[itemIdx] = head;
+  head = (uint32_t)itemIdx;
+
+  if (firstWaiter) {
+    // For each rule X -> Y in the grammar,
+    // if X == sym, add an item X -> •Y in chart[pos].
+    // (origin = pos)
+    for (int rule : grammar.rulesFor(sym)) {
+      if (addItem(grammar.dotted(rule, 0), pos)) {
+        PARSER_TRACE(trace, TraceKind::EarleyPredict, 0, rule, (uint32_t)pos);
       }
-      else {
-        // dot is at the end -> COMPLETE
-        // For each item in chart[item.startIdx],
-        // if the next symbol matches item.head, move dot forward
-        bool completedSomething = false;
-
-        // We'll examine all items in chart[item.startIdx].
-        std::vector<EarleyItem> startItems(chart[item.startIdx].begin(),
-                                           chart[item.startIdx].end());
-
-        for (auto &stItem : startItems) {
-          if (stItem.dotPos < stItem.body.size()) {
-            // check the next symbol
-            char stSym = stItem.body[stItem.dotPos];
-            // if that symbol is the completed item's head
-            if (std::string(1, stSym) == item.head) {
-              // push dot forward
-              EarleyItem newItem = stItem;
-              newItem.dotPos++;
-
-              // Insert in chart[pos] (the position we’re “completing” at)
-              auto ins = chart[pos].insert(newItem);
-              if (ins.second) {
-                changed = true;
-                completedSomething = true;
-              }
-            }
-          }
-        }
+    }
+  }
 
-        if (completedSomething) {
-          std::ostringstream msg;
-          msg << "Earley: COMPLETE at chart[" << pos << "]: "
-              << item.head << " -> " << item.body << " •";
-          stepExplanations.push_back(msg.str());
-        }
+  // Aycock-Horspool: sym can derive ε, so the dot may skip it right
+  // away. This makes the single pass correct without having to wait
+  // for (or remember) the empty completion of sym in this column.
+  // In the forest, sym's child is the node (sym, pos, pos); its
+  // families are filled in as sym's empty completions happen here.
+  if (grammar.isNullable(sym)) {
+    EarleyItem item = items[itemIdx];
+    if (buildForest) {
+      addItem(item.dottedRule + 1, item.origin, itemNodes[itemIdx], symbolNode(sym, pos), pos);
+    } else {
+      addItem(item.dottedRule + 1, item.origin);
+    }
+  }
+}
+
+// items[itemIdx] is A -> γ•, origin k: advance every item in chart[k]
+// that waits on A.
+void EarleyParser::complete(size_t pos, size_t itemIdx) {
+  EarleyItem item = items[itemIdx];
+  int rule = grammar.dottedRuleOf(item.dottedRule);
+  SymbolId head = grammar.ruleHead(rule);
+
+  // Leo: if chart[origin] has a deterministic reduction path for head,
+  // add only its topmost item. (Not for the open column, which may
+  // still get more items waiting on head.)
+  if (useLeo && !buildForest && item.origin < pos) {
+    if (const EarleyItem *top = leoItem(item.origin, head)) {
+      EarleyItem topItem = *top;
+      if (addItem(topItem.dottedRule, topItem.origin)) {
+        PARSER_TRACE(trace, TraceKind::EarleyLeoComplete, 0, rule, (uint32_t)pos,
+                     topItem.dottedRule, topItem.origin);
       }
+      return;
+    }
+  }
+
+  const uint32_t *waiters = waitingHeads.find((uint64_t(item.origin) << 32) | uint32_t(head));
+  bool completedSomething = false;
+  SPPFNodeId completedNode = buildForest ? itemNodes[itemIdx] : NoNode;
+  for (uint32_t j = waiters ? *waiters : UINT32_MAX; j != UINT32_MAX; j = nextWaiting[j]) {
+    EarleyItem stItem = items[j];
+    // push dot forward, insert in chart[pos] (the position we’re “completing” at)
+    if (addItem(stItem.dottedRule + 1, stItem.origin,
+                buildForest ? itemNodes[j] : NoNode, completedNode, item.origin)) {
+      completedSomething = true;
+    }
+  }
+
+  if (completedSomething) {
+    PARSER_TRACE(trace, TraceKind::EarleyComplete, 0, rule, (uint32_t)pos);
+  }
+}
+
+/**************************************************
+ * LEO ITEMS
+ * chart[column] has a deterministic reduction path for
+ * `sym` when exactly one item waits on sym there and sym
+ * is the last symbol of that item (B -> α•sym, origin j).
+ * The topmost item of the path is then Leo(j, B) if that
+ * exists, else B -> α sym•, origin j. Results are memoized,
+ * so each (column, symbol) is resolved once.
+ **************************************************/
+const EarleyItem *EarleyParser::leoItem(size_t column, SymbolId sym) {
+  // Walk down the path until we hit a memoized entry or its end, then
+  // fill in the memo for every step on the way back.
+  std::vector<std::pair<size_t, SymbolId>> path;
+  uint32_t top = NoLeoItem;
+  size_t col = column;
+  SymbolId s = sym;
+  while (true) {
+    uint64_t key = (uint64_t(col) << 32) | uint32_t(s);
+    bool isNew;
+    uint32_t &memo = leoMemo.findOrInsert(key, NoLeoItem, isNew);
+    if (!isNew) {
+      // Already resolved (or being resolved: unit cycles within one column)
+      top = memo;
+      break;
+    }
+
+    const uint32_t *waiters = waitingHeads.find(key);
+    EarleyItem waiter{};
+    bool unique = waiters && *waiters != UINT32_MAX && nextWaiting[*waiters] == UINT32_MAX;
+    if (unique) {
+      waiter = items[*waiters];
+      unique = grammar.isCompleted(waiter.dottedRule + 1);
+    }
+    if (!unique) {
+      break; // memo stays NoLeoItem
     }
+
+    path.emplace_back(col, s);
+    EarleyItem advanced{waiter.dottedRule + 1, waiter.origin};
+    leoTops.push_back(advanced); // provisional top for this step
+    memo = (uint32_t)leoTops.size() - 1;
+    col = waiter.origin;
+    s = grammar.ruleHead(grammar.dottedRuleOf(waiter.dottedRule));
+  }
+
+  // Everything on the path shares the topmost item found at the end:
+  // a memoized one, or else the item of the last step we took
+  if (top == NoLeoItem && !path.empty()) {
+    top = (uint32_t)leoTops.size() - 1;
   }
-}
\ No newline at end of file
+  if (top != NoLeoItem) {
+    EarleyItem topItem = leoTops[top];
+    for (auto &step : path) {
+      bool isNew;
+      leoTops[leoMemo.findOrInsert((uint64_t(step.first) << 32) | uint32_t(step.second),
+                                   NoLeoItem, isNew)] = topItem;
+    }
+  }
+
+  bool isNew;
+  uint32_t idx = leoMemo.findOrInsert((uint64_t(column) << 32) | uint32_t(sym), NoLeoItem, isNew);
+  return idx == NoLeoItem ? nullptr : &leoTops[idx];
+}
@@ -6,48 +6,68 @@
 *   EarleyParser parser(cfg);
 *   bool ok = parser.parse("abba");
 *
+*   // or, one parser per thread on a grammar compiled once:
+*   EarleyParser parser(compiledGrammar);
+*
 * Features:
 *   - Step-by-step or one-shot parse
 *   - Chart-based approach
-*   - Single-character tokens
+*   - Single-character tokens, integer-coded symbols (GrammarIndex)
 *   - Augmented grammar for acceptance
-*   - Detailed stepExplanations for each stage
+*   - Epsilon rules via precomputed nullable sets (Aycock-Horspool)
+*   - Opt-in structured tracing of each stage (ParseTrace.h)
 **************************************************/
 
+#ifndef EARLEYPARSER_H
+#define EARLEYPARSER_H
+
 #include <vector>
-#include <set>
+#include <cstdint>
 #include <string>
 #include <stdexcept>
 #include <algorithm>
-#include <sstream>
 #include <iostream>
 
 // Include your existing CFG class header:
 #include "CFG.h"
+#include "CompiledGrammar.h"
+#include "ParseForest.h"
+#include "ParseTrace.h"
+#include "PackedHashMap.h"
 
 /**************************************************
 * Data Structures
 **************************************************/
 
-// An Earley item: A -> α • β, startIndex
-// `head` = A, `body` = αβ, `dotPos` is where the "•" is.
-// `startIdx` is which chart column the item originated from.
+// An Earley item: A -> α • β, startIndex, packed into 8 bytes.
+// `dottedRule` is the GrammarIndex id of (A -> αβ, dot position),
+// `origin` is which chart column the item originated from.
 struct EarleyItem {
- std::string head;  // e.g. "S"
- std::string body;  // e.g. "aB" (string of symbols)
- size_t dotPos;     // dot position in the body
- size_t startIdx;   // index of the chart where this item began
-
- bool operator<(const EarleyItem &o) const {
-   if (head != o.head) return head < o.head;
-   if (body != o.body) return body < o.body;
-   if (dotPos != o.dotPos) return dotPos < o.dotPos;
-   return startIdx < o.startIdx;
- }
+ uint32_t dottedRule; // GrammarIndex::dotted(rule, dot)
+ uint32_t origin;     // index of the chart where this item began
 
  bool operator==(const EarleyItem &o) const {
-   return head == o.head && body == o.body &&
-          dotPos == o.dotPos && startIdx == o.startIdx;
+   return dottedRule == o.dottedRule && origin == o.origin;
+ }
+ uint64_t key() const { return (uint64_t(dottedRule) << 32) | origin; }
+};
+
+// Read-only view of the whole chart: all items live in one flat,
+// append-only array and column i is the range [start[i], start[i+1]).
+// Columns that have not been reached yet are empty.
+struct EarleyChartView {
+ const EarleyItem *items = nullptr;
+ const size_t *columnStarts = nullptr;
+ size_t startedColumns = 0; // entries in columnStarts
+ size_t itemCount = 0;
+ size_t columns = 0;        // input length + 1
+
+ size_t size() const { return columns; }
+ bool empty() const { return columns == 0; }
+ IdRange<EarleyItem> operator[](size_t i) const {
+   if (i >= startedColumns) return {items + itemCount, items + itemCount};
+   size_t end = (i + 1 < startedColumns) ? columnStarts[i + 1] : itemCount;
+   return {items + columnStarts[i], items + end};
  }
 };
 
@@ -58,6 +78,8 @@ class EarleyParser {
 public:
  // Construct with reference to a CFG
  explicit EarleyParser(const CFG &cfg);
+ // Construct on a shared grammar; the parser only holds per-parse state
+ explicit EarleyParser(std::shared_ptr<const CompiledGrammar> compiled);
 
  // Parse the entire string at once
  bool parse(const std::string &input);
@@ -69,24 +91,68 @@ public:
  bool isAccepted() const { return accepted; }
 
  // Return the chart for external visualization
- // chart[i] = set of items after i tokens consumed
- const std::vector<std::set<EarleyItem>>& getChart() const { return chart; }
-
- // Logging/explanations for each step
- std::vector<std::string> stepExplanations;
+ // chart[i] = items after i tokens consumed
+ EarleyChartView getChart() const;
+
+ // Events of each step go to `sink` (nullptr = no tracing, the default).
+ // The sink must outlive the parses it records.
+ void setTraceSink(TraceSink *sink) { trace = sink; }
+
+ // The compiled grammar the items refer to (for rendering items)
+ const GrammarIndex &getGrammar() const { return grammar; }
+
+ // Leo's right-recursion optimization (off by default). Completions
+ // jump straight to the topmost item of a deterministic reduction
+ // path, which makes right-recursive grammars parse in linear time.
+ // The intermediate items of such paths are then missing from the chart.
+ void setLeoItems(bool enabled) { useLeo = enabled; }
+ bool usesLeoItems() const { return useLeo; }
+
+ // Build a shared packed parse forest while parsing (off by default).
+ // After an accepted parse, getForest().root() is the start symbol's
+ // node spanning the whole input. Leo items are not used while the
+ // forest is built, since they skip the items the forest is made of.
+ void setBuildForest(bool enabled) { buildForest = enabled; }
+ const ParseForest &getForest() const { return forest; }
 
 private:
- const CFG &cfg;
-
- // Storing the grammar’s start symbol + an augmented start symbol
- std::string startSymbol;     // e.g. "S"
- std::string augmentedSymbol; // e.g. "S'"
+ // Integer-coded grammar, shared; rule 0 is the augmented S' -> S
+ std::shared_ptr<const CompiledGrammar> compiled;
+ const GrammarIndex &grammar;
 
  // The input string (plus we handle it char-by-char)
  std::string currentInput;
 
- // The chart: for an input of length n, we have chart[0..n]
- std::vector<std::set<EarleyItem>> chart;
+ // The chart: for an input of length n, we have columns 0..n.
+ // Columns are completed one after another, so they can all share one
+ // append-only vector; columnStarts[i] is where column i begins.
+ std::vector<EarleyItem> items;
+ std::vector<size_t> columnStarts;
+ // Dedupe for the column that is currently growing
+ PackedHashMap openColumn;
+
+ // Items waiting on a nonterminal: (column, symbol) -> first item index,
+ // further waiters are chained through nextWaiting (parallel to items).
+ PackedHashMap waitingHeads;
+ std::vector<uint32_t> nextWaiting;
+ // Leo transitive items: (column, symbol) -> index in leoTops, or
+ // NoLeoItem when the column has no deterministic path for the symbol
+ bool useLeo = false;
+ PackedHashMap leoMemo;
+ std::vector<EarleyItem> leoTops;
+ static constexpr uint32_t NoLeoItem = UINT32_MAX;
+
+ // SPPF construction: itemNodes[i] is the forest node of items[i].
+ // Symbol nodes ending in the open column are shared through
+ // symbolNodes ((A, start) -> node); familySeen dedupes derivations
+ // per (item, split position).
+ bool buildForest = false;
+ ParseForest forest;
+ std::vector<SPPFNodeId> itemNodes;
+ PackedHashMap symbolNodes;
+ PackedHashMap familySeen;
+
+ TraceSink *trace = nullptr;
 
  // The current position in the input
  size_t currentPos = 0;
@@ -96,10 +162,19 @@ private:
  bool accepted = false;
 
  // Helpers for scanning, predicting, completing
- bool isNonTerminal(const std::string &symbol) const;
- bool isTerminal(char symbol) const;
+ bool isNonTerminal(SymbolId symbol) const { return grammar.isNonTerminal(symbol); }
+ bool isTerminal(SymbolId symbol) const { return grammar.isTerminal(symbol); }
 
  // Step subroutines
+ void startColumn();
+ bool addItem(uint32_t dottedRule, size_t origin,
+              SPPFNodeId left = NoNode, SPPFNodeId right = NoNode, size_t split = 0);
+ SPPFNodeId symbolNode(SymbolId sym, size_t start);
  void scan(char nextChar);
  void predictAndComplete(size_t pos);
+ void predict(size_t pos, size_t itemIdx, SymbolId sym);
+ void complete(size_t pos, size_t itemIdx);
+ const EarleyItem *leoItem(size_t column, SymbolId sym);
 };
+
+#endif // EARLEYPARSER_H
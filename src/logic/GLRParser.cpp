@@ -2,22 +2,21 @@
 #include <queue>
 #include <stdexcept>
 #include <algorithm>
-#include <set>
 // --------------------------------------------
 // Implementation
 // --------------------------------------------
 
-GLRParser::GLRParser(const CFG &cfg) : cfg(cfg) {
-  // Collect symbols:
-  startSymbol = cfg.getStartSymbol();
-  nonTerminals = cfg.getNonTerminals();
-  terminals = cfg.getTerminals();
-  // We'll treat '$' as the end marker:
-  terminals.insert('$');
-
-  buildRules();         // Build internal rules list (including augmented)
-  buildLR0Automaton();  // Build the LR(0) states
-  buildTables();        // Create SHIFT/REDUCE/ACCEPT actions
+GLRParser::GLRParser(const CFG &cfg, LRTableKind kind)
+    : GLRParser(CompiledGrammar::compile(cfg), kind) {}
+
+GLRParser::GLRParser(std::shared_ptr<const CompiledGrammar> compiledGrammar, LRTableKind kind)
+    : compiled(std::move(compiledGrammar)), grammar(compiled->getGrammar()),
+      tables(compiled->lrTables(kind)) {
+  // The GrammarIndex already holds the augmented rule S' -> S (rule 0)
+  // and the end marker "$" (symbol 0); the automaton is built once per
+  // CompiledGrammar and table kind.
+  nodeOfState.assign(tables.stateCount, 0);
+  nodeStamp.assign(tables.stateCount, 0);
 }
 
 bool GLRParser::parse(const std::string &input) {
@@ -30,544 +29,354 @@ bool GLRParser::parse(const std::string &input) {
 
 // Step-by-step init
 void GLRParser::reset(const std::string &input) {
-  currentInput = input + "$";
+  // Map the characters to terminal ids; a character that is not a
+  // terminal can never be shifted, which rejects the input.
+  currentInput.clear();
+  for (char c : input) {
+    currentInput.push_back(grammar.terminalFor(c));
+  }
+  currentInput.push_back(grammar.endMarker());
   currentPos = 0;
+  shiftsDone = 0;
+  reductionsDone = 0;
   finished = false;
   accepted = false;
-  stepExplanations.clear();
-
-  // Clear GSS
-  currentTops.clear();
-
-  // Create an initial node for state 0
-  auto root = std::make_shared<GSSNode>();
-  root->state = 0;
-  root->preds.clear();
-
-  currentTops.push_back(root);
+  pendingReduces.clear();
+  pendingShifts.clear();
+
+  // Empty the arena, keeping its memory
+  gssNodes.clear();
+  gssEdges.clear();
+  levelStart.clear();
+  visitMark.clear();
+
+  // The bottom of the stack has state 0
+  lrStack.clear();
+  lrBase = NoGSSNode;
+  deterministic = useFastPath;
+  if (deterministic) {
+    lrStack.push_back(StackEntry{ 0, 0 });
+    return;
+  }
 
-  // For debugging / visualization, store snapshots
-  stackSnapshots.clear();
-  stackSnapshots.resize(currentInput.size() + 1);
-  stackSnapshots[0].topNodes = currentTops;
+  // In state 0 only empty (or right-nulled length 0) reductions are possible
+  startLevel();
+  GSSNodeId root = addNode(0);
+  queueActions(root, NoGSSNode, currentInput[0], true);
 }
 
-// Step-by-step iteration
+// One step = one input position: all reductions of level i, then the
+// shifts that build level i+1
 bool GLRParser::nextStep() {
   if (finished) return false;
-  if (currentPos >= currentInput.size()) {
-    // We are at or beyond the end -> accept if possible
-    // If a node has an ACCEPT action on '$', that means success
-    bool foundAccept = false;
-    for (auto &top : currentTops) {
-      int st = top->state;
-      auto it = actionTable.find({st, '$'});
-      if (it != actionTable.end() && it->second.type == ActionType::Accept) {
-        foundAccept = true;
+  size_t level = currentPos;
+  size_t n = currentInput.size() - 1;
+
+  // Plain LR while there is one stack; it hands over to the GSS below
+  // when it reaches a conflict
+  if (deterministic && runDeterministic(level)) {
+    return !finished;
+  }
+
+  while (!pendingReduces.empty()) {
+    reducer(level);
+  }
+
+  if (level == n) {
+    // Accept if a node of the last level can accept on '$'
+    auto [first, last] = gssLevel(level);
+    for (GSSNodeId id = first; id < last; id++) {
+      if (canAccept(gssNodes[id].state)) {
+        accepted = true;
         break;
       }
     }
-    if (foundAccept) {
-      accepted = true;
-      stepExplanations.push_back("GLR: Accepted at end of input.");
+    if (accepted) {
+      PARSER_TRACE(trace, TraceKind::GLRAccept, 0, 0, (uint32_t)level);
     } else {
-      stepExplanations.push_back("GLR: No more input, and no accept state. Rejected.");
+      PARSER_TRACE(trace, TraceKind::GLRReject, 0, 0, (uint32_t)level);
     }
     finished = true;
     return false;
   }
 
-  // Next input symbol:
-  char a = currentInput[currentPos];
-
-  // We'll track newly formed top nodes after SHIFT/REDUCE
-  // Because we can expand by reduce multiple times and also have multiple SHIFT paths
-  // We'll do an iterative approach until no more expansions.
-  bool changedSomething = true;
+  shifter(level);
+  currentPos++;
 
-  // We hold a queue of "active" GSS nodes to process for reduce,
-  // because multiple reduces can happen from each top.
-  std::queue<std::shared_ptr<GSSNode>> queue;
-  for (auto &t : currentTops) queue.push(t);
+  // No stack could shift the input symbol
+  auto [first, last] = gssLevel(currentPos);
+  if (first == last) {
+    PARSER_TRACE(trace, TraceKind::GLRReject, 0, 0, (uint32_t)currentPos);
+    finished = true;
+    accepted = false;
+  } else if (useFastPath && last - first == 1) {
+    // The stacks have merged into one top again
+    leaveGSSMode(first);
+  }
 
-  // We'll hold the next set of top nodes after SHIFT:
-  std::vector<std::shared_ptr<GSSNode>> newTops = currentTops;
+  return !finished;
+}
 
-  // We'll do multiple passes for all possible reduce expansions
-  // before we do SHIFT from each top.
-  std::set<std::shared_ptr<GSSNode>> visited; // to avoid infinite loops on merges
+/****************************************************
+ * Deterministic fast path
+ ****************************************************/
 
-  while (!queue.empty()) {
-    auto node = queue.front();
-    queue.pop();
-    if (visited.count(node)) continue;
-    visited.insert(node);
+// Runs plain LR on lrStack for one input position. Returns true if the
+// step is done (shifted, accepted or rejected), false if it reached a
+// point only the GSS can handle; the stack has then been moved into the
+// GSS with the pending actions of its top queued.
+bool GLRParser::runDeterministic(size_t level) {
+  SymbolId a = currentInput[level];
+  while (true) {
+    int s = lrStack.empty() ? gssNodes[lrBase].state : lrStack.back().state;
+    IdRange<LRAction> cell = actionsFor(s, a);
+    if (cell.empty()) {
+      PARSER_TRACE(trace, TraceKind::GLRReject, 0, 0, (uint32_t)level);
+      finished = true;
+      return true;
+    }
+    if (cell.size() != 1) break; // conflict: fork in the GSS
 
-    int st = node->state;
-    // 1) Check for ACCEPT on this node if a == '$' and dot is at end
-    auto acceptIt = actionTable.find({st,'$'});
-    if (a == '$' && acceptIt!=actionTable.end() && acceptIt->second.type == ActionType::Accept) {
+    const LRAction &act = cell[0];
+    if (act.type == ActionType::Accept) {
+      PARSER_TRACE(trace, TraceKind::GLRAccept, 0, 0, (uint32_t)level);
       accepted = true;
       finished = true;
-      stepExplanations.push_back("GLR: Accepted at pos " + std::to_string(currentPos));
-      stackSnapshots[currentPos].topNodes = currentTops;
-      return false;
+      return true;
     }
-
-    // 2) Check for REDUCE on (st, a) or (st, '$')
-    bool foundReduce = false;
-    for (char maybeTerm : {a, '$'}) {
-      auto it = actionTable.find({st, maybeTerm});
-      if (it != actionTable.end() && it->second.type == ActionType::Reduce) {
-        // We have a reduce by some rule
-        int ruleId = it->second.stateOrRule;
-        performReduce(node, ruleId);
-
-        // After reduce, new GSS nodes might appear as new "tops."
-        // We push them on queue for further expansions.
-        // Because we store them in newTops in performReduce,
-        // we do queue expansions below.
-        foundReduce = true;
-        // We don't break; we keep checking both a and '$' for reduce
-      }
+    if (act.type == ActionType::Shift) {
+      PARSER_TRACE(trace, TraceKind::GLRShift, 0, 0, (uint32_t)level, (uint32_t)s, (uint32_t)act.stateOrRule);
+      shiftsDone++;
+      lrStack.push_back(StackEntry{ act.stateOrRule, (uint32_t)level + 1 });
+      currentPos++;
+      return true;
     }
-    // If we did any reduce, new top nodes might have formed
-    // We'll push them all to the queue to see if they can reduce further
-    // (multiple reduce expansions in a row).
-    if (foundReduce) {
-      for (auto &tnew : stackSnapshots[currentPos].topNodes) {
-        if (!visited.count(tnew)) {
-          queue.push(tnew);
-        }
+
+    // REDUCE: pop `length` states. Popping past the array continues in
+    // the GSS below lrBase, which is fine as long as that path is unique.
+    size_t k = lrStack.size();
+    size_t m = (size_t)act.length;
+    size_t keep = 0;
+    GSSNodeId below = NoGSSNode;
+    int belowState;
+    if (m < k) {
+      keep = k - m;
+      belowState = lrStack[keep - 1].state;
+    } else {
+      if (lrBase == NoGSSNode) break;
+      if (m == k) {
+        below = lrBase;
+      } else {
+        nodesAtDistance(lrBase, (int)(m - k), pathScratch);
+        if (pathScratch.size() != 1) break;
+        below = pathScratch[0];
       }
+      belowState = gssNodes[below].state;
     }
-  }
 
-  // Now that we have done all possible reduces, let's SHIFT on 'a'
-  // from every top node if SHIFT is valid.
-  std::vector<std::shared_ptr<GSSNode>> shiftResults;
-  for (auto &top : stackSnapshots[currentPos].topNodes) {
-    int st = top->state;
-    auto actIt = actionTable.find({st, a});
-    if (actIt != actionTable.end() && actIt->second.type == ActionType::Shift) {
-      int nextSt = actIt->second.stateOrRule;
-      performShift(top, nextSt);
-    }
-  }
+    int l = gotoState(belowState, grammar.ruleHead(act.stateOrRule));
+    // A state that is already in this level means a cycle of empty
+    // reductions, which only the GSS merges
+    if (l < 0 || stateInLevel(l, level, keep)) break;
 
-  // After SHIFT, we must do a round of reduces again
-  // (some grammars have immediate reduce after shift).
-  // We'll store the newly SHIFTed top nodes into a fresh container:
-  std::set<std::shared_ptr<GSSNode>> shiftTops;
-  for (auto &t : currentTops) {
-    if (t->state == -1) continue; // if we used placeholders
-    shiftTops.insert(t);
+    PARSER_TRACE(trace, TraceKind::GLRReduce, 0, act.stateOrRule, (uint32_t)level, 0, (uint32_t)l);
+    reductionsDone++;
+    lrStack.resize(keep);
+    if (keep == 0) lrBase = below;
+    lrStack.push_back(StackEntry{ l, (uint32_t)level });
   }
 
-  // The SHIFT has advanced currentPos by 1 symbol, so we do that at the *end*:
-  currentPos++;
-
-  // Now we do another reduce wave at *currentPos*.
-  // Because after SHIFT, we are effectively at new position in the input.
-  if (currentPos < stackSnapshots.size()) {
-    // For the newly SHIFTed position, we do the same reduce expansions
-    // but let's do them in the same pattern:
-    std::queue<std::shared_ptr<GSSNode>> wave;
-    for (auto &t : shiftTops) wave.push(t);
-
-    std::set<std::shared_ptr<GSSNode>> visited2;
-    while (!wave.empty()) {
-      auto node = wave.front();
-      wave.pop();
-      if (visited2.count(node)) continue;
-      visited2.insert(node);
-
-      int st = node->state;
-      // Possibly accept if a == '$' (not likely if we just SHIFTed, but for completeness):
-      auto acceptIt = actionTable.find({st,'$'});
-      if (acceptIt!=actionTable.end() && acceptIt->second.type == ActionType::Accept) {
-        accepted = true;
-        finished = true;
-        stepExplanations.push_back("GLR: Accepted after shift at pos " + std::to_string(currentPos));
-        stackSnapshots[currentPos].topNodes = currentTops;
-        return false;
-      }
+  enterGSSMode(level);
+  return false;
+}
 
-      // Check reduce for "next input symbol" (which is currentInput[currentPos], if we haven't advanced further).
-      if (currentPos < currentInput.size()) {
-        char nextSym = currentInput[currentPos];
-        for (char maybeTerm : {nextSym, '$'}) {
-          auto it = actionTable.find({st, maybeTerm});
-          if (it != actionTable.end() && it->second.type == ActionType::Reduce) {
-            int ruleId = it->second.stateOrRule;
-            performReduce(node, ruleId);
-            // queue newly formed tops
-            for (auto &nt : stackSnapshots[currentPos].topNodes) {
-              if (!visited2.count(nt)) {
-                wave.push(nt);
-              }
-            }
-          }
-        }
-      } else {
-        // If we are at end, check reduce on '$'
-        auto it = actionTable.find({st, '$'});
-        if (it != actionTable.end() && it->second.type == ActionType::Reduce) {
-          performReduce(node, it->second.stateOrRule);
-          for (auto &nt : stackSnapshots[currentPos].topNodes) {
-            if (!visited2.count(nt)) {
-              wave.push(nt);
-            }
-          }
-        }
-      }
-    }
+// Whether `state` is on the stack in `level`, among the first `keep`
+// array entries or the GSS nodes of that level
+bool GLRParser::stateInLevel(int state, size_t level, size_t keep) const {
+  for (size_t i = keep; i > 0 && lrStack[i - 1].level == level; i--) {
+    if (lrStack[i - 1].state == state) return true;
   }
+  return gssLevelCount() == level + 1 && findNode(state) != NoGSSNode;
+}
 
-  // Save the final top nodes for this position:
-  if (currentPos < stackSnapshots.size()) {
-    stackSnapshots[currentPos].topNodes = currentTops;
+// Moves lrStack into the GSS and queues the actions of its top, as if
+// the top had just been created. Everything below the top has already
+// done its one action.
+void GLRParser::enterGSSMode(size_t level) {
+  GSSNodeId top = lrBase;
+  for (const StackEntry &e : lrStack) {
+    while (gssLevelCount() <= e.level) startLevel();
+    GSSNodeId node = addNode(e.state);
+    if (top != NoGSSNode) addEdge(node, top);
+    top = node;
   }
+  lrStack.clear();
+  lrBase = NoGSSNode;
+  deterministic = false;
 
-  // If after all SHIFT/REDUCE expansions, we have no top nodes, it's a reject
-  if (stackSnapshots[currentPos].topNodes.empty()) {
-    stepExplanations.push_back("GLR: No valid configurations at pos " + std::to_string(currentPos) + ". Rejected.");
-    finished = true;
-    accepted = false;
-    return false;
+  SymbolId a = currentInput[level];
+  if (gssNodes[top].firstEdge == NoGSSEdge) {
+    queueActions(top, NoGSSNode, a, true);
   }
-
-  // If not at end, we continue
-  if (currentPos >= currentInput.size()) {
-    // We might have ended exactly on the '$', check acceptance:
-    bool foundAccept = false;
-    for (auto &top : currentTops) {
-      auto it = actionTable.find({top->state, '$'});
-      if (it != actionTable.end() && it->second.type == ActionType::Accept) {
-        foundAccept = true;
-        break;
-      }
-    }
-    if (foundAccept) {
-      accepted = true;
-      stepExplanations.push_back("GLR: Accepted exactly at input end pos=" + std::to_string(currentPos));
-    } else {
-      stepExplanations.push_back("GLR: Input ended, but no accept. Rejected.");
-    }
-    finished = true;
+  bool first = true;
+  for (uint32_t e = gssNodes[top].firstEdge; e != NoGSSEdge; e = gssEdges[e].next) {
+    queueActions(top, gssEdges[e].to, a, first);
+    first = false;
   }
+}
 
-  return !finished;
+// The level just shifted has the single node `top`: continue on the
+// array stack above it. Its queued actions are recomputed from the table.
+void GLRParser::leaveGSSMode(GSSNodeId top) {
+  pendingReduces.clear();
+  pendingShifts.clear();
+  lrStack.clear();
+  lrBase = top;
+  deterministic = true;
 }
 
 /****************************************************
- * Implementation Details
+ * GLR Step Internals
  ****************************************************/
 
-void GLRParser::buildRules() {
-  // First, build an augmented rule: S' -> S
-  GLRRule aug;
-  aug.head = startSymbol + "'";
-  aug.body.push_back(startSymbol);
-  aug.id = 0;
-  rules.push_back(aug);
-
-  int ruleCount = 1;
-  // Next, gather rules from the CFG
-  for (auto &pr : cfg.getProductionRules()) {
-    const std::string &A = pr.first;
-    for (auto &rhs : pr.second) {
-      GLRRule r;
-      r.head = A;
-      r.id = ruleCount++;
-      // For each char in rhs, store as symbol
-      for (char c : rhs) {
-        r.body.push_back(std::string(1, c));
-      }
-      rules.push_back(r);
-    }
-  }
-}
-
-LRState GLRParser::closure(const LRState &I) {
-  LRState result = I;
-  bool changed = true;
-  while (changed) {
-    changed = false;
-    // snapshot the items so we can iterate
-    auto itemsVec = std::vector<LRItem>(result.items.begin(), result.items.end());
-    for (auto &it : itemsVec) {
-      int ruleId = it.ruleId;
-      size_t dot = it.dotPos;
-      if (dot < rules[ruleId].body.size()) {
-        // next symbol
-        std::string X = rules[ruleId].body[dot];
-        if (isNonTerminal(X)) {
-          // for each rule that has X as head, add (ruleX, dot=0)
-          for (auto &r : rules) {
-            if (r.head == X) {
-              LRItem ni{r.id, 0};
-              if (result.items.insert(ni).second) {
-                changed = true;
-              }
-            }
-          }
+// Queues the actions of `node` (in the current level) on `lookahead`.
+// `edgeTo` is the edge just added below it: reductions of length > 0
+// are queued along that edge only, since the node's older edges have
+// already had theirs. Shifts and empty reductions only depend on the
+// state, so they are queued once, when the node is new.
+void GLRParser::queueActions(GSSNodeId node, GSSNodeId edgeTo, SymbolId lookahead, bool newNode) {
+  for (const LRAction &act : actionsFor(gssNodes[node].state, lookahead)) {
+    if (act.type == ActionType::Shift) {
+      if (newNode) pendingShifts.push_back(PendingShift{ node, act.stateOrRule });
+    } else if (act.type == ActionType::Reduce) {
+      if (act.length > 0) {
+        if (edgeTo != NoGSSNode) {
+          pendingReduces.push_back(PendingReduce{ node, act.stateOrRule, act.length, edgeTo });
         }
+      } else if (newNode) {
+        pendingReduces.push_back(PendingReduce{ node, act.stateOrRule, 0, NoGSSNode });
       }
     }
   }
-  return result;
-}
-
-LRState GLRParser::goTo(const LRState &I, const std::string &X) {
-  LRState dst;
-  for (auto &item : I.items) {
-    const GLRRule &rule = rules[item.ruleId];
-    if (item.dotPos < rule.body.size() && rule.body[item.dotPos] == X) {
-      LRItem ni{ item.ruleId, item.dotPos + 1 };
-      dst.items.insert(ni);
-    }
-  }
-  if (!dst.items.empty()) {
-    dst = closure(dst);
-  }
-  return dst;
-}
-
-int GLRParser::findOrAddState(const LRState &st) {
-  // see if st is in states
-  for (int i = 0; i < (int)states.size(); i++) {
-    if (states[i] == st) {
-      return i;
-    }
-  }
-  states.push_back(st);
-  return (int)states.size() - 1;
 }
 
-void GLRParser::buildLR0Automaton() {
-  // Create initial state I0
-  LRState I0;
-  // Augmented rule is #0: S'->S
-  // we add item (ruleId=0, dotPos=0)
-  I0.items.insert({0,0});
-  I0 = closure(I0);
-
-  states.clear();
-  int s0 = findOrAddState(I0);
-
-  // BFS or queue approach
-  std::queue<int> Q;
-  Q.push(s0);
-
-  // gather all possible symbols
-  std::set<std::string> allSymbols;
-  for (auto &r : rules) {
-    for (auto &b : r.body) {
-      allSymbols.insert(b);
-    }
+// REDUCER: takes one pending reduction and performs it along every path
+// of its length that starts with its first edge
+void GLRParser::reducer(size_t level) {
+  PendingReduce r = pendingReduces.back();
+  pendingReduces.pop_back();
+  SymbolId head = grammar.ruleHead(r.rule);
+  SymbolId lookahead = currentInput[level];
+
+  std::vector<GSSNodeId> targets;
+  if (r.length == 0) {
+    targets.push_back(r.node);
+  } else {
+    nodesAtDistance(r.firstEdge, r.length - 1, targets);
   }
 
-  while (!Q.empty()) {
-    int s = Q.front(); Q.pop();
-    for (auto &X : allSymbols) {
-      LRState nxt = goTo(states[s], X);
-      if (!nxt.items.empty()) {
-        int idx = findOrAddState(nxt);
-        // if new, push it
-        if (idx == (int)states.size()-1 && idx != s) {
-          Q.push(idx);
-        }
-      }
+  for (GSSNodeId w : targets) {
+    int l = gotoState(gssNodes[w].state, head);
+    if (l < 0) continue;
+
+    GSSNodeId u = findNode(l);
+    if (u != NoGSSNode) {
+      if (!addEdge(u, w)) continue;
+      PARSER_TRACE(trace, TraceKind::GLRReduce, 0, r.rule, (uint32_t)level, 0, (uint32_t)l);
+      reductionsDone++;
+      // An edge made by an empty reduction gets no new reductions: the
+      // right-nulled reductions already cover every path through it
+      if (r.length != 0) queueActions(u, w, lookahead, false);
+    } else {
+      u = addNode(l);
+      addEdge(u, w);
+      PARSER_TRACE(trace, TraceKind::GLRReduce, 0, r.rule, (uint32_t)level, 0, (uint32_t)l);
+      reductionsDone++;
+      queueActions(u, w, lookahead, true);
     }
   }
 }
 
-void GLRParser::buildTables() {
-  // build SHIFT, REDUCE, ACCEPT
-  // For each state:
-  for (int i = 0; i < (int)states.size(); i++) {
-    const LRState &st = states[i];
-    // For each item in st:
-    for (auto &item : st.items) {
-      const GLRRule &r = rules[item.ruleId];
-      // If dotPos < length, SHIFT if next symbol is terminal
-      if (item.dotPos < r.body.size()) {
-        std::string X = r.body[item.dotPos];
-        // SHIFT
-        if (X.size() == 1 && isTerminal(X[0])) {
-          LRState nxt = goTo(st, X);
-          if (!nxt.items.empty()) {
-            // find the state
-            int ns = -1;
-            for (int j = 0; j < (int)states.size(); j++) {
-              if (states[j] == nxt) {
-                ns = j;
-                break;
-              }
-            }
-            if (ns < 0) {
-              // In a fully correct GLR, we can create a new state on the fly
-              // But we found a missing state => add it
-              ns = (int)states.size();
-              states.push_back(nxt);
-            }
-            LRAction a;
-            a.type = ActionType::Shift;
-            a.stateOrRule = ns;
-            actionTable[{ i, X[0] }] = a;
-          }
-        }
-        // GOTO if X is nonterminal
-        else if (isNonTerminal(X)) {
-          LRState nxt = goTo(st, X);
-          if (!nxt.items.empty()) {
-            int ns = -1;
-            for (int j = 0; j < (int)states.size(); j++) {
-              if (states[j] == nxt) {
-                ns = j;
-                break;
-              }
-            }
-            if (ns < 0) {
-              ns = (int)states.size();
-              states.push_back(nxt);
-            }
-            gotoTable[{ i, X }] = ns;
-          }
-        }
-      } else {
-        // dot is at the end => REDUCE
-        if (r.id == 0) {
-          // if it's the augmented rule and dot at end => ACCEPT
-          LRAction a;
-          a.type = ActionType::Accept;
-          a.stateOrRule = -1;
-          // accept for terminal = '$'
-          actionTable[{ i, '$' }] = a;
-        } else {
-          // normal reduce
-          LRAction a;
-          a.type = ActionType::Reduce;
-          a.stateOrRule = r.id;
-
-          // The typical approach is to reduce on *all terminals*, plus '$'.
-          // In a true LR(0) parser, we'd typically do LR(1) lookahead sets.
-          // For GLR, we'll assign reduce to every possible terminal & '$'.
-          for (char t : terminals) {
-            // If SHIFT or ACCEPT is also set, we have a conflict => GLR can handle it by forking
-            // but this code merges them in one table, which we do by overwriting or ignoring conflicts
-            // For a complete solution, you’d store multiple actions in a conflict scenario.
-            actionTable[{ i, t }] = a;
-          }
-        }
-      }
-    }
+// SHIFTER: performs the pending shifts of `level`, which builds level+1
+// and queues its actions on the next lookahead
+void GLRParser::shifter(size_t level) {
+  std::vector<PendingShift> shifts;
+  shifts.swap(pendingShifts);
+  SymbolId lookahead = currentInput[level + 1];
+
+  startLevel();
+  for (const PendingShift &sh : shifts) {
+    GSSNodeId w = findNode(sh.state);
+    bool isNew = (w == NoGSSNode);
+    if (isNew) w = addNode(sh.state);
+    addEdge(w, sh.node);
+    PARSER_TRACE(trace, TraceKind::GLRShift, 0, 0, (uint32_t)level,
+                 (uint32_t)gssNodes[sh.node].state, (uint32_t)sh.state);
+    shiftsDone++;
+    queueActions(w, sh.node, lookahead, isNew);
   }
 }
 
 /****************************************************
- * GLR Step Internals
+ * GSS helpers
  ****************************************************/
 
-void GLRParser::performShift(std::shared_ptr<GSSNode> top, int nextState) {
-  // SHIFT: create or find a GSS node for nextState, with predecessor= top
-  auto newNode = findOrCreateGSSNode(nextState, {top});
-  // Add newNode to currentTops (the top set for the new position).
-  // We'll do that in stackSnapshots[currentPos+1] typically,
-  // but let's unify: we store them in currentTops as well.
-  currentTops.push_back(newNode);
-
-  std::ostringstream msg;
-  msg << "GLR: SHIFT from state " << top->state << " to state " << nextState;
-  stepExplanations.push_back(msg.str());
+// Opens the next level: nodes and edges created from now on belong to it
+void GLRParser::startLevel() {
+  levelStart.push_back((GSSNodeId)gssNodes.size());
+  levelEdges.clear();
+  if (++levelSerial == 0) {
+    // the stamps wrapped around: forget them all
+    std::fill(nodeStamp.begin(), nodeStamp.end(), 0);
+    levelSerial = 1;
+  }
 }
 
-void GLRParser::performReduce(std::shared_ptr<GSSNode> top, int ruleId) {
-  // REDUCE: pop as many symbols as the body length, then goto
-  const GLRRule &r = rules[ruleId];
-  int popCount = (int)r.body.size();
-
-  // We'll do a BFS from top's predecessors up to popCount levels
-  // but in a GSS, multiple paths might exist. We collect all states
-  // that are exactly popCount edges above.
-
-  // We create a queue of (node, remaining pops)
-  struct Frame {
-    std::shared_ptr<GSSNode> node;
-    int remain;
-  };
-  std::queue<Frame> Q;
-  Q.push({top, popCount});
-
-  // We'll collect all predecessor states that are exactly popCount up
-  std::vector<std::shared_ptr<GSSNode>> reduceSources;
-
-  while (!Q.empty()) {
-    auto f = Q.front();
-    Q.pop();
-    if (f.remain == 0) {
-      // This node is a final candidate
-      reduceSources.push_back(f.node);
-    } else {
-      // push all preds with remain-1
-      for (auto &p : f.node->preds) {
-        Q.push({p, f.remain - 1});
-      }
-    }
-  }
+// Node with `state` in the level being built, NoGSSNode if none
+GSSNodeId GLRParser::findNode(int state) const {
+  return nodeStamp[state] == levelSerial ? nodeOfState[state] : NoGSSNode;
+}
 
-  // Now, from each reduceSources node, we do a GOTO on r.head
-  for (auto &src : reduceSources) {
-    int st = src->state;
-    auto itGoto = gotoTable.find({ st, r.head });
-    if (itGoto == gotoTable.end()) {
-      // In a fully general GLR, might create new state on the fly
-      // or skip if no valid goto
-      continue;
-    }
-    int nextSt = itGoto->second;
-    auto newNode = findOrCreateGSSNode(nextSt, {src});
-    currentTops.push_back(newNode);
-
-    std::ostringstream msg;
-    msg << "GLR: REDUCE by rule " << r.id << " (" << r.head << " -> ";
-    for (auto &x : r.body) msg << x;
-    msg << "), goto state " << nextSt;
-    stepExplanations.push_back(msg.str());
-  }
+GSSNodeId GLRParser::addNode(int state) {
+  GSSNodeId id = (GSSNodeId)gssNodes.size();
+  gssNodes.push_back(GSSNode{ state, NoGSSEdge });
+  visitMark.push_back(0);
+  nodeOfState[state] = id;
+  nodeStamp[state] = levelSerial;
+  return id;
+}
 
-  // We unify merges in findOrCreateGSSNode.
+// Adds the edge from -> to (from is in the level being built); false if
+// it already exists
+bool GLRParser::addEdge(GSSNodeId from, GSSNodeId to) {
+  bool inserted;
+  levelEdges.findOrInsert((uint64_t(from) << 32) | to, 0, inserted);
+  if (!inserted) return false;
+  gssEdges.push_back(GSSEdge{ to, gssNodes[from].firstEdge });
+  gssNodes[from].firstEdge = (uint32_t)gssEdges.size() - 1;
+  return true;
 }
 
-std::shared_ptr<GSSNode> GLRParser::findOrCreateGSSNode(int state, const std::vector<std::shared_ptr<GSSNode>> &preds) {
-  // For performance, you’d keep a cache of existing GSSNodes keyed by (state, set-of-preds).
-  // For simplicity, we just create a new node and possibly unify if we find an identical existing top.
-  // We'll unify if same state and same set of preds.
-  // Real Tomita merges them if same <state> but let’s do a simpler approach.
-
-  // 1) Check if there's already a top node with the same state
-  for (auto &t : currentTops) {
-    if (t->state == state) {
-      // Merge preds
-      for (auto &p : preds) {
-        // Avoid duplicates
-        bool alreadyThere = false;
-        for (auto &ex : t->preds) {
-          if (ex == p) { alreadyThere = true; break; }
-        }
-        if (!alreadyThere) {
-          t->preds.push_back(p);
+// The distinct nodes at the end of the paths of `distance` edges from
+// `start`. A recognizer only needs the end points, not the paths.
+void GLRParser::nodesAtDistance(GSSNodeId start, int distance, std::vector<GSSNodeId> &out) {
+  out.assign(1, start);
+  std::vector<GSSNodeId> next;
+  for (int d = 0; d < distance; d++) {
+    if (++visitEpoch == 0) {
+      std::fill(visitMark.begin(), visitMark.end(), 0);
+      visitEpoch = 1;
+    }
+    next.clear();
+    for (GSSNodeId node : out) {
+      for (uint32_t e = gssNodes[node].firstEdge; e != NoGSSEdge; e = gssEdges[e].next) {
+        GSSNodeId to = gssEdges[e].to;
+        if (visitMark[to] != visitEpoch) {
+          visitMark[to] = visitEpoch;
+          next.push_back(to);
         }
       }
-      // Return the existing node
-      return t;
     }
+    out.swap(next);
   }
-
-  // 2) Not found => create a new node
-  auto node = std::make_shared<GSSNode>();
-  node->state = state;
-  node->preds = preds;
-  return node;
-}
\ No newline at end of file
+}
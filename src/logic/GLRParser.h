@@ -1,104 +1,71 @@
 /****************************************************
 * GLRParser.cpp - A fully implemented Tomita GLR
 *
-*
-*
+* The engine is Scott & Johnstone's RNGLR ("Right Nulled
+* GLR Parsers", TOPLAS 2006): correct on every CFG, including
+* epsilon rules and hidden left recursion.
 * Exposes:
-*   - GLRParser constructor: GLRParser(const CFG &cfg)
+*   - GLRParser constructor: GLRParser(const CFG &cfg), or on a shared
+*     CompiledGrammar, whose LR tables all its parsers use
+*     (the parser itself only holds the state of one parse)
 *   - bool parse(const std::string &input)
 *   - Step-by-step methods (reset/nextStep/isDone/isAccepted)
 *   - A method to access a parse forest, if you want to build it
 *
-* This code uses LR(0) items for its state machine,
-* but merges states dynamically (classic Tomita).
+* The state machine is LALR(1) by default (canonical LR(1)
+* on request), so reductions only fork the stack where the
+* next input symbol allows them. Items A -> α•β with a
+* nullable β reduce right away by |α| (right-nulled
+* reductions), so nullable suffixes never need their own
+* empty reductions.
 ****************************************************/
 
+#ifndef GLRPARSER_H
+#define GLRPARSER_H
+
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <set>
-#include <memory>
 #include <queue>
 #include <algorithm>
 #include <stdexcept>
 #include <iostream>
-#include <sstream>
 #include <optional>
+#include <cstdint>
 
 // Include your CFG header:
 #include "CFG.h"
+#include "CompiledGrammar.h"
+#include "ParseTrace.h"
+#include "PackedHashMap.h"
 
 /****************************************************
 * Data Structures
 ****************************************************/
 
-// A production rule:  head -> body
-// Example: S' -> S
-struct GLRRule {
- std::string head;            // Nonterminal (e.g. "S")
- std::vector<std::string> body; // Sequence of symbols (e.g. {"A", "b", "C"})
- int id;                     // Unique ID for referencing
-};
-
-// LR(0) item: rule # plus dot position
-// Example:  (ruleId=2, dotPos=1) means: for the rule #2 "S->a b",
-// the dot is after the first symbol.
-struct LRItem {
- int ruleId;     // which rule
- size_t dotPos;  // dot position in that rule's RHS
-
- bool operator<(const LRItem &o) const {
-   if (ruleId != o.ruleId) return ruleId < o.ruleId;
-   return dotPos < o.dotPos;
- }
- bool operator==(const LRItem &o) const {
-   return (ruleId == o.ruleId && dotPos == o.dotPos);
- }
-};
-
-// A set of LR items is one LR(0) state:
-struct LRState {
- std::set<LRItem> items;
- bool operator==(const LRState &o) const {
-   return items == o.items;
- }
-};
-
-// Parser actions:
-enum class ActionType { Shift, Reduce, Accept, Error };
-
-struct LRAction {
- ActionType type;
- int stateOrRule; // SHIFT -> new state, REDUCE -> which rule, ACCEPT -> -1
-};
+// Graph-Structured Stack. Nodes and edges live in flat arrays that are
+// reused from parse to parse and refer to each other by index. A node's
+// edges (down to the nodes it was pushed on top of, in the same or an
+// earlier level) form an intrusive list through GSSEdge::next.
+using GSSNodeId = uint32_t;
+constexpr uint32_t NoGSSEdge = UINT32_MAX;
 
-// Graph-Structured Stack node (Tomita approach).
-// Each node holds a state index plus links to predecessor nodes.
-// Multiple paths can merge if they share the same <predecessors, state>.
 struct GSSNode {
- int state;  // LR automaton state
- // The set of parent links:
- std::vector<std::shared_ptr<GSSNode>> preds;
-
- // We override equality to let us detect merges:
- bool equals(const GSSNode &other) const {
-   // In practice, we typically also compare the set of preds,
-   // but for a proper GSS, we let them unify if (state) matches
-   // and they eventually share the same preds. We'll unify them
-   // in the parser code with a dedicated "findOrCreateGSSNode" function.
-   return state == other.state;
- }
+ int state;           // LR automaton state
+ uint32_t firstEdge;  // index into the edge array, NoGSSEdge if none
 };
 
-// For step-by-step:
-struct StackSnapshot {
- // We'll store pointers to GSS nodes that are "tops" at a given point in input
- std::vector<std::shared_ptr<GSSNode>> topNodes;
+struct GSSEdge {
+ GSSNodeId to;
+ uint32_t next;       // next edge of the same node, NoGSSEdge at the end
 };
 
 class GLRParser {
 public:
- explicit GLRParser(const CFG &cfg);
+ explicit GLRParser(const CFG &cfg, LRTableKind kind = LRTableKind::LALR1);
+ explicit GLRParser(std::shared_ptr<const CompiledGrammar> compiled, LRTableKind kind = LRTableKind::LALR1);
 
  // Full parse:
  bool parse(const std::string &input);
@@ -109,49 +76,122 @@ public:
  bool isDone() const { return finished; }
  bool isAccepted() const { return accepted; }
 
- // Explanation messages for each step:
- std::vector<std::string> stepExplanations;
+ // Events of each step go to `sink` (nullptr = no tracing, the default)
+ void setTraceSink(TraceSink *sink) { trace = sink; }
+
+ // Deterministic fast path (on by default): while only one stack is
+ // live the parser runs a plain LR loop on an array stack, and moves
+ // it into the GSS at the first conflict. When a GSS level shrinks to
+ // a single node it drops back to the array stack.
+ void setFastPath(bool enabled) { useFastPath = enabled; }
+ bool usesFastPath() const { return useFastPath; }
+
+ // The compiled grammar (for rendering trace events)
+ const GrammarIndex &getGrammar() const { return grammar; }
+
+ // The GSS level by level: level i has the nodes after reading i
+ // symbols. Nodes are created level after level, so a level is a
+ // contiguous id range [first, last). Stretches parsed on the fast
+ // path have no GSS nodes.
+ size_t gssLevelCount() const { return levelStart.size(); }
+ std::pair<GSSNodeId, GSSNodeId> gssLevel(size_t i) const {
+   GSSNodeId end = i + 1 < levelStart.size() ? levelStart[i + 1] : (GSSNodeId)gssNodes.size();
+   return { levelStart[i], end };
+ }
+ const GSSNode &gssNode(GSSNodeId id) const { return gssNodes[id]; }
+ const GSSEdge &gssEdge(uint32_t idx) const { return gssEdges[idx]; }
+ size_t gssNodeCount() const { return gssNodes.size(); }
+ size_t gssEdgeCount() const { return gssEdges.size(); }
 
- // Snapshots for each position in the input:
- // stackSnapshots[i] has the GSS top nodes after reading i symbols
- std::vector<StackSnapshot> stackSnapshots;
+ // Stack steps of the last parse, on the fast path and in the GSS
+ // alike (a GSS step is one new edge, so merged stacks count once)
+ size_t shiftCount() const { return shiftsDone; }
+ size_t reduceCount() const { return reductionsDone; }
 
 private:
- // The grammar from CFG
- const CFG &cfg;
-
- // LR(0) automaton + action/goto tables
- std::vector<GLRRule> rules;                       // all rules (including augmented)
- std::vector<LRState> states;                      // all LR(0) states
- std::map<std::pair<int,std::string>,int> gotoTable;     // GOTO: (state, X) -> newState
- std::map<std::pair<int,char>, LRAction> actionTable;     // ACTION: (state, terminal) -> SHIFT/REDUCE/ACCEPT
- std::set<std::string> nonTerminals;
- std::set<char> terminals;
- std::string startSymbol;  // e.g. "S"
-
- // GLR parsing runtime:
- std::vector<std::shared_ptr<GSSNode>> currentTops; // top nodes of the GSS
- std::string currentInput;
+ // Shared, immutable grammar and tables (rule 0 = S' -> S)
+ std::shared_ptr<const CompiledGrammar> compiled;
+ const GrammarIndex &grammar;
+ const LRTables &tables;
+
+ // RNGLR runtime. Pending reductions (R): reduce `rule` by `length`
+ // symbols from `node`; for length > 0 the path starts with the edge
+ // node -> `firstEdge`. Pending shifts (Q) are per level.
+ struct PendingReduce {
+   GSSNodeId node;
+   int rule;
+   int length;
+   GSSNodeId firstEdge;
+ };
+ struct PendingShift {
+   GSSNodeId node;
+   int state;
+ };
+ std::vector<PendingReduce> pendingReduces;
+ std::vector<PendingShift> pendingShifts;
+ std::vector<SymbolId> currentInput;                // terminal ids, ends with "$"
+
+ // Fast path: the single live stack, sitting on the GSS node lrBase
+ // (NoGSSNode when the stack starts at the bottom)
+ struct StackEntry {
+   int state;
+   uint32_t level;
+ };
+ bool useFastPath = true;
+ bool deterministic = false;
+ std::vector<StackEntry> lrStack;
+ GSSNodeId lrBase = UINT32_MAX;
+ std::vector<GSSNodeId> pathScratch;
+
+ // GSS arena (cleared, not freed, by reset)
+ std::vector<GSSNode> gssNodes;
+ std::vector<GSSEdge> gssEdges;
+ std::vector<GSSNodeId> levelStart;
+ // State -> node of the level being built. An entry is valid only if
+ // its stamp is levelSerial, which counts levels across parses, so
+ // nothing has to be cleared between levels or parses.
+ std::vector<GSSNodeId> nodeOfState;
+ std::vector<uint32_t> nodeStamp;
+ uint32_t levelSerial = 0;
+ // Edges out of the level being built, (from << 32) | to
+ PackedHashMap levelEdges;
+ // Scratch for path walks: visitMark[node] == visitEpoch means seen
+ std::vector<uint32_t> visitMark;
+ uint32_t visitEpoch = 0;
  size_t currentPos = 0;
+ size_t shiftsDone = 0;
+ size_t reductionsDone = 0;
  bool finished = false;
  bool accepted = false;
+ TraceSink *trace = nullptr;
 
- // Building the automaton:
- void buildRules();
- LRState closure(const LRState &I);
- LRState goTo(const LRState &I, const std::string &X);
- int findOrAddState(const LRState &st);
- void buildLR0Automaton();
- void buildTables();
+ // Table lookups (one array index each)
+ IdRange<LRAction> actionsFor(int state, SymbolId terminal) const { return tables.actionsFor(state, terminal); }
+ int gotoState(int state, SymbolId nonTerminal) const {
+   return tables.gotoState(state, grammar.nonTerminalIndex(nonTerminal));
+ }
+ bool canAccept(int state) const { return tables.canAccept(state, grammar.endMarker()); }
 
  // GLR step logic:
- void performShift(std::shared_ptr<GSSNode> top, int nextState);
- void performReduce(std::shared_ptr<GSSNode> top, int ruleId);
+ bool runDeterministic(size_t level);
+ bool stateInLevel(int state, size_t level, size_t keep) const;
+ void enterGSSMode(size_t level);
+ void leaveGSSMode(GSSNodeId top);
+ void reducer(size_t level);
+ void shifter(size_t level);
+ static constexpr GSSNodeId NoGSSNode = UINT32_MAX;
+ void queueActions(GSSNodeId node, GSSNodeId edgeTo, SymbolId lookahead, bool newNode);
 
  // GSS helpers:
- std::shared_ptr<GSSNode> findOrCreateGSSNode(int state, const std::vector<std::shared_ptr<GSSNode>> &preds);
+ void startLevel();
+ GSSNodeId findNode(int state) const;
+ GSSNodeId addNode(int state);
+ bool addEdge(GSSNodeId from, GSSNodeId to);
+ void nodesAtDistance(GSSNodeId start, int distance, std::vector<GSSNodeId> &out);
 
  // Symbol classification:
- inline bool isNonTerminal(const std::string &sym) const { return nonTerminals.count(sym) > 0; }
- inline bool isTerminal(char sym) const { return terminals.count(sym) > 0; }
-};
\ No newline at end of file
+ inline bool isNonTerminal(SymbolId sym) const { return grammar.isNonTerminal(sym); }
+ inline bool isTerminal(SymbolId sym) const { return grammar.isTerminal(sym); }
+};
+
+#endif // GLRPARSER_H
@@ -0,0 +1,208 @@
+#include "GrammarCache.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct CFGCHeader {
+  char magic[4];          // "CFGC"
+  uint32_t version;
+  uint32_t byteOrder;     // ByteOrderMark as written by the producer
+  uint32_t actionSize;    // sizeof(LRAction)
+  uint64_t fingerprint;
+  uint32_t kind;          // LRTableKind
+  uint32_t checksum;      // of everything after the header
+  uint64_t stateCount;
+  uint64_t terminalCount;
+  uint64_t nonTerminalCount;
+  uint64_t actionCount;
+};
+static_assert(sizeof(CFGCHeader) == 64, "the .cfgc header is 64 bytes");
+
+constexpr uint32_t ByteOrderMark = 0x01020304;
+
+size_t aligned(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+// FNV-1a over 8-byte words (the sections are padded to 8), folded to 32
+// bits: any changed word changes the running hash
+uint32_t checksum(const char *data, size_t bytes) {
+  uint64_t h = 1469598103934665603ull;
+  for (size_t i = 0; i < bytes; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    h ^= word;
+    h *= 1099511628211ull;
+  }
+  return uint32_t(h ^ (h >> 32));
+}
+
+} // namespace
+
+GrammarCache::GrammarCache(std::string directory) : directory(std::move(directory)) {}
+
+std::string GrammarCache::pathFor(uint64_t fingerprint, LRTableKind kind) const {
+  char name[48];
+  std::snprintf(name, sizeof(name), "%016llx-%s.cfgc", (unsigned long long)fingerprint,
+                kind == LRTableKind::LALR1 ? "lalr1" : "lr1");
+  return (std::filesystem::path(directory) / name).string();
+}
+
+std::shared_ptr<const CompiledGrammar> GrammarCache::load(const CFG &cfg, LRTableKind kind) {
+  return withTables(CompiledGrammar::compile(cfg), cfg.fingerprint(), kind);
+}
+
+std::shared_ptr<const CompiledGrammar> GrammarCache::load(const BinaryGrammar &binary, LRTableKind kind) {
+  return withTables(CompiledGrammar::compile(binary), binary.fingerprint(), kind);
+}
+
+std::shared_ptr<const CompiledGrammar> GrammarCache::withTables(std::shared_ptr<const CompiledGrammar> compiled,
+                                                                uint64_t fingerprint, LRTableKind kind) {
+  std::string path = pathFor(fingerprint, kind);
+
+  LRTables tables;
+  if (read(path, fingerprint, kind, compiled->getGrammar(), tables)) {
+    hitCount++;
+    compiled->provideLRTables(std::move(tables));
+    return compiled;
+  }
+
+  missCount++;
+  const LRTables &built = compiled->lrTables(kind);
+  try {
+    std::filesystem::create_directories(directory);
+    write(path, fingerprint, built);
+  } catch (const std::exception &) {
+    // best effort: the tables are built, only the next start is slower
+  }
+  return compiled;
+}
+
+/**************************************************
+ * File format
+ **************************************************/
+
+bool GrammarCache::read(const std::string &path, uint64_t fingerprint, LRTableKind kind,
+                        const GrammarIndex &grammar, LRTables &out) {
+  auto file = std::make_shared<MappedFile>(path);
+  if (file->size() < sizeof(CFGCHeader)) return false;
+
+  CFGCHeader header;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, "CFGC", 4) != 0 || header.version != FormatVersion ||
+      header.byteOrder != ByteOrderMark || header.actionSize != sizeof(LRAction) ||
+      header.fingerprint != fingerprint || header.kind != (uint32_t)kind ||
+      header.terminalCount != grammar.terminalCount() ||
+      header.nonTerminalCount != grammar.nonTerminalCount()) {
+    return false;
+  }
+
+  // Section sizes must add up to the file size exactly. The counts are
+  // bounded by the file size first, so the products cannot overflow.
+  if (header.stateCount == 0 || header.stateCount > file->size() || header.actionCount > file->size()) {
+    return false;
+  }
+  size_t cells = header.stateCount * header.terminalCount;
+  size_t startBytes = aligned((cells + 1) * sizeof(uint32_t));
+  size_t actionBytes = aligned(header.actionCount * sizeof(LRAction));
+  size_t gotoBytes = aligned(header.stateCount * header.nonTerminalCount * sizeof(int32_t));
+  if (file->size() != sizeof(CFGCHeader) + startBytes + actionBytes + gotoBytes) return false;
+
+  // A flipped bit can leave every entry in range, so the range checks
+  // below only protect the parsers; the checksum catches the rest
+  const char *base = file->data() + sizeof(CFGCHeader);
+  if (checksum(base, file->size() - sizeof(CFGCHeader)) != header.checksum) return false;
+  const uint32_t *actionStart = reinterpret_cast<const uint32_t *>(base);
+  const LRAction *actions = reinterpret_cast<const LRAction *>(base + startBytes);
+  const int32_t *gotoTable = reinterpret_cast<const int32_t *>(base + startBytes + actionBytes);
+  if (actionStart[0] != 0 || actionStart[cells] != header.actionCount) return false;
+
+  // The parsers index with these entries unchecked, so a file that
+  // passes the header checks but holds garbage must still be a miss
+  for (size_t c = 0; c < cells; c++) {
+    if (actionStart[c] > actionStart[c + 1]) return false;
+  }
+  for (size_t i = 0; i < header.actionCount; i++) {
+    const LRAction &act = actions[i];
+    switch (act.type) {
+      case ActionType::Shift:
+        if (act.stateOrRule < 0 || (uint64_t)act.stateOrRule >= header.stateCount) return false;
+        break;
+      case ActionType::Reduce:
+        if (act.stateOrRule < 0 || (size_t)act.stateOrRule >= grammar.ruleCount() ||
+            act.length < 0 || (size_t)act.length > grammar.ruleLength(act.stateOrRule)) {
+          return false;
+        }
+        break;
+      case ActionType::Accept:
+      case ActionType::Error:
+        break;
+      default:
+        return false;
+    }
+  }
+  size_t gotoCells = header.stateCount * header.nonTerminalCount;
+  for (size_t i = 0; i < gotoCells; i++) {
+    if (gotoTable[i] < -1 || (uint64_t)gotoTable[i] + 1 > header.stateCount) return false;
+  }
+
+  out.kind = kind;
+  out.stateCount = header.stateCount;
+  out.terminalCount = header.terminalCount;
+  out.nonTerminalCount = header.nonTerminalCount;
+  out.actionStart = { actionStart, actionStart + cells + 1 };
+  out.actions = { actions, actions + header.actionCount };
+  out.gotoTable = { gotoTable, gotoTable + gotoCells };
+  out.storage = std::move(file);
+  return true;
+}
+
+void GrammarCache::write(const std::string &path, uint64_t fingerprint, const LRTables &tables) {
+  CFGCHeader header{};
+  std::memcpy(header.magic, "CFGC", 4);
+  header.version = FormatVersion;
+  header.byteOrder = ByteOrderMark;
+  header.actionSize = sizeof(LRAction);
+  header.fingerprint = fingerprint;
+  header.kind = (uint32_t)tables.kind;
+  header.stateCount = tables.stateCount;
+  header.terminalCount = tables.terminalCount;
+  header.nonTerminalCount = tables.nonTerminalCount;
+  header.actionCount = tables.actions.size();
+
+  // The sections are assembled first so the header can carry their checksum
+  std::string payload;
+  auto append = [&](const void *data, size_t bytes) {
+    payload.append(static_cast<const char *>(data), bytes);
+    payload.append(aligned(bytes) - bytes, '\0');
+  };
+  append(tables.actionStart.begin(), tables.actionStart.size() * sizeof(uint32_t));
+  append(tables.actions.begin(), tables.actions.size() * sizeof(LRAction));
+  append(tables.gotoTable.begin(), tables.gotoTable.size() * sizeof(int32_t));
+  header.checksum = checksum(payload.data(), payload.size());
+
+  std::string temporary = path + ".tmp" + std::to_string(std::random_device()());
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) throw std::runtime_error("Unable to write " + temporary);
+    auto section = [&](const void *data, size_t bytes) {
+      static const char zeros[8] = {};
+      file.write(static_cast<const char *>(data), (std::streamsize)bytes);
+      file.write(zeros, (std::streamsize)(aligned(bytes) - bytes));
+    };
+    section(&header, sizeof(header));
+    section(payload.data(), payload.size());
+    if (!file) throw std::runtime_error("Unable to write " + temporary);
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    throw std::runtime_error("Unable to write " + path);
+  }
+}
@@ -0,0 +1,76 @@
+/**************************************************
+* GrammarCache.h - Compiled LR tables on disk, keyed by grammar fingerprint
+*
+* Usage:
+*   GrammarCache cache("cache/");
+*   std::shared_ptr<const CompiledGrammar> g = cache.load(cfg);
+*   GLRParser parser(g);                  // no automaton construction
+*
+* A .cfgc file holds the ACTION/GOTO tables of one grammar and table
+* kind and is named after CFG::fingerprint(). load() memory-maps it and
+* the parsers read the tables straight from the mapping, after one pass
+* that checks the checksum and that every entry is in range. On a miss
+* (no file, another format version, another grammar, a damaged file)
+* the tables are built and written for next time, to a temporary name
+* that is then renamed, so concurrent processes never see half a file.
+* The GrammarIndex is linear to build and is not cached.
+*
+* Layout, native byte order, sections 8-byte aligned:
+*   header    (magic "CFGC", version, byte order mark, sizeof(LRAction),
+*              fingerprint, table kind, checksum, table dimensions)
+*   uint32_t  actionStart[stateCount * terminalCount + 1]
+*   LRAction  actions[actionCount]
+*   int32_t   gotoTable[stateCount * nonTerminalCount]
+**************************************************/
+
+#ifndef GRAMMARCACHE_H
+#define GRAMMARCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "BinaryGrammar.h"
+#include "CFG.h"
+#include "CompiledGrammar.h"
+#include "LRTables.h"
+
+class GrammarCache {
+public:
+ // Bumped whenever the layout or the table construction changes
+ static constexpr uint32_t FormatVersion = 2;
+
+ // The directory is created on the first write
+ explicit GrammarCache(std::string directory);
+
+ // cfg compiled, with the `kind` tables from the cache when there is a
+ // matching file, otherwise built now and stored. A cache that cannot
+ // be written only costs the rebuild next time.
+ std::shared_ptr<const CompiledGrammar> load(const CFG &cfg, LRTableKind kind = LRTableKind::LALR1);
+ // Same for a .cfgb grammar; it carries the fingerprint of its source,
+ // so both share one cache entry
+ std::shared_ptr<const CompiledGrammar> load(const BinaryGrammar &binary, LRTableKind kind = LRTableKind::LALR1);
+
+ std::string pathFor(uint64_t fingerprint, LRTableKind kind) const;
+ size_t hits() const { return hitCount; }
+ size_t misses() const { return missCount; }
+
+ // Maps the tables of `path` into `out`. False if the file is missing,
+ // does not hold tables of this version, fingerprint, kind and grammar
+ // shape, fails its checksum, or has a shift/goto target, reduce rule or
+ // length out of range.
+ static bool read(const std::string &path, uint64_t fingerprint, LRTableKind kind,
+                  const GrammarIndex &grammar, LRTables &out);
+ // Throws std::runtime_error when the file cannot be written
+ static void write(const std::string &path, uint64_t fingerprint, const LRTables &tables);
+
+private:
+ std::shared_ptr<const CompiledGrammar> withTables(std::shared_ptr<const CompiledGrammar> compiled,
+                                                  uint64_t fingerprint, LRTableKind kind);
+
+ std::string directory;
+ size_t hitCount = 0;
+ size_t missCount = 0;
+};
+
+#endif // GRAMMARCACHE_H
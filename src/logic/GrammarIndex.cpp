@@ -0,0 +1,197 @@
+#include "GrammarIndex.h"
+#include "BinaryGrammar.h"
+#include <stdexcept>
+
+/**************************************************
+ * Construction
+ **************************************************/
+
+GrammarIndex::GrammarIndex(const CFG &cfg) {
+  charToTerminal.fill(NoSymbol);
+
+  // 1) End marker + terminals get the low ids, so terminal-indexed
+  //    tables can simply use [0, terminalCount()).
+  intern("$", Terminal);
+  for (char t : cfg.getTerminals()) {
+    charToTerminal[(unsigned char)t] = intern(std::string(1, t), Terminal);
+  }
+  numTerminals = names.size();
+
+  // 2) Declared nonterminals, then heads that were never declared
+  for (const auto &nt : cfg.getNonTerminals()) {
+    intern(nt, NonTerminal);
+  }
+  for (const auto &rule : cfg.getProductionRules()) {
+    intern(rule.first, NonTerminal);
+  }
+  if (cfg.getStartSymbol().empty()) {
+    throw std::runtime_error("GrammarIndex: grammar has no start symbol");
+  }
+  start = intern(cfg.getStartSymbol(), NonTerminal);
+
+  // 3) Rule bodies. A symbol that is neither a declared terminal nor a
+  //    known nonterminal becomes a nonterminal without rules, so the
+  //    rules using it simply never match.
+  std::vector<std::pair<SymbolId, std::vector<SymbolId>>> collected;
+  for (const auto &rule : cfg.getProductionRules()) {
+    SymbolId head = ids.at(rule.first);
+    for (const auto &body : rule.second) {
+      std::vector<SymbolId> syms;
+      for (const auto &name : body) {
+        auto it = ids.find(name);
+        syms.push_back(it != ids.end() ? it->second : intern(name, NonTerminal));
+      }
+      collected.emplace_back(head, std::move(syms));
+    }
+  }
+
+  // 4) Augmented start symbol S' and rule 0, S' -> S
+  addAugmentedRule();
+
+  // 5) Flatten: the rest of the rules follow the CFG's order
+  for (auto &rule : collected) {
+    heads.push_back(rule.first);
+    bodySymbols.insert(bodySymbols.end(), rule.second.begin(), rule.second.end());
+    bodyOffsets.push_back((uint32_t)bodySymbols.size());
+  }
+
+  indexRules();
+}
+
+GrammarIndex::GrammarIndex(const BinaryGrammar &binary) {
+  charToTerminal.fill(NoSymbol);
+
+  // File symbol s is id s + 1, right after the end marker. The writer
+  // numbered them like the CFG constructor does, so no sorting here.
+  names.reserve(binary.symbolCount() + 2);
+  kinds.reserve(binary.symbolCount() + 2);
+  intern("$", Terminal);
+  for (uint32_t s = 0; s < binary.symbolCount(); s++) {
+    Kind kind = binary.isTerminal(s) ? Terminal : NonTerminal;
+    SymbolId id = intern(std::string(binary.symbolName(s)), kind);
+    if (id != SymbolId(s + 1)) {
+      throw std::runtime_error("GrammarIndex: symbol \"" + names[id] + "\" occurs twice");
+    }
+    if (kind == Terminal) charToTerminal[(unsigned char)names[id][0]] = id;
+  }
+  numTerminals = binary.terminalCount() + 1;
+  start = SymbolId(binary.startSymbol() + 1);
+
+  addAugmentedRule();
+
+  heads.reserve(binary.productionCount() + 1);
+  bodyOffsets.reserve(binary.productionCount() + 2);
+  bodySymbols.reserve(binary.bodySymbolCount() + 1);
+  for (size_t p = 0; p < binary.productionCount(); p++) {
+    heads.push_back(SymbolId(binary.productionHead(p) + 1));
+    for (uint32_t sym : binary.productionBody(p)) {
+      bodySymbols.push_back(SymbolId(sym + 1));
+    }
+    bodyOffsets.push_back((uint32_t)bodySymbols.size());
+  }
+
+  indexRules();
+}
+
+void GrammarIndex::addAugmentedRule() {
+  // Add quotes until the name is free
+  std::string augName = names[start] + "'";
+  while (ids.count(augName)) augName += "'";
+  augmented = intern(augName, NonTerminal);
+
+  bodyOffsets.push_back(0);
+  heads.push_back(augmented);
+  bodySymbols.push_back(start);
+  bodyOffsets.push_back((uint32_t)bodySymbols.size());
+}
+
+// Head index, dotted rules and nullable set, all derived from the
+// flat rule arrays
+void GrammarIndex::indexRules() {
+  // Head index (counting sort into CSR form)
+  headOffsets.assign(nonTerminalCount() + 1, 0);
+  for (SymbolId h : heads) {
+    headOffsets[nonTerminalIndex(h) + 1]++;
+  }
+  for (size_t i = 1; i < headOffsets.size(); i++) {
+    headOffsets[i] += headOffsets[i - 1];
+  }
+  headRules.resize(heads.size());
+  std::vector<uint32_t> fill(headOffsets.begin(), headOffsets.end() - 1);
+  for (int r = 0; r < (int)heads.size(); r++) {
+    headRules[fill[nonTerminalIndex(heads[r])]++] = r;
+  }
+
+  // Dotted rules: rule r with length L owns the ids dotted(r,0..L)
+  for (int r = 0; r < (int)heads.size(); r++) {
+    IdRange<SymbolId> body = ruleBody(r);
+    for (size_t dot = 0; dot <= body.size(); dot++) {
+      dottedRule.push_back(r);
+      afterDot.push_back(dot < body.size() ? body[dot] : NoSymbol);
+    }
+  }
+
+  computeNullable();
+}
+
+// Worklist fixpoint, linear in the grammar size: every rule counts the
+// body symbols not yet known to be nullable, and a symbol that becomes
+// nullable decrements the count of each rule it occurs in.
+void GrammarIndex::computeNullable() {
+  nullable.assign(symbolCount(), 0);
+  std::vector<size_t> remaining(ruleCount());
+  std::vector<std::vector<int>> occursIn(symbolCount());
+  std::vector<SymbolId> worklist;
+
+  for (int r = 0; r < (int)ruleCount(); r++) {
+    remaining[r] = ruleLength(r);
+    for (SymbolId sym : ruleBody(r)) {
+      occursIn[sym].push_back(r);
+    }
+    if (remaining[r] == 0 && !nullable[heads[r]]) {
+      nullable[heads[r]] = 1;
+      worklist.push_back(heads[r]);
+    }
+  }
+
+  while (!worklist.empty()) {
+    SymbolId sym = worklist.back();
+    worklist.pop_back();
+    for (int r : occursIn[sym]) {
+      if (--remaining[r] == 0 && !nullable[heads[r]]) {
+        nullable[heads[r]] = 1;
+        worklist.push_back(heads[r]);
+      }
+    }
+  }
+}
+
+SymbolId GrammarIndex::intern(const std::string &name, Kind kind) {
+  auto it = ids.find(name);
+  if (it != ids.end()) return it->second;
+  SymbolId id = (SymbolId)names.size();
+  names.push_back(name);
+  kinds.push_back(kind);
+  ids.emplace(name, id);
+  return id;
+}
+
+/**************************************************
+ * Lookups
+ **************************************************/
+
+SymbolId GrammarIndex::findSymbol(const std::string &name) const {
+  auto it = ids.find(name);
+  return it != ids.end() ? it->second : NoSymbol;
+}
+
+std::string GrammarIndex::ruleToString(int rule, int dot) const {
+  std::string out = names[heads[rule]] + " -> ";
+  IdRange<SymbolId> body = ruleBody(rule);
+  for (size_t i = 0; i < body.size(); i++) {
+    if ((int)i == dot) out += "•";
+    out += names[body[i]];
+  }
+  if (dot == (int)body.size()) out += "•";
+  return out;
+}
@@ -0,0 +1,139 @@
+/**************************************************
+* GrammarIndex.h - Compiled, integer-coded form of a CFG
+*
+* Usage:
+*   CFG cfg("grammar.json");
+*   GrammarIndex g(cfg);
+*   for (int r : g.rulesFor(g.startSymbol())) { ... }
+*
+* Every symbol gets a dense integer id:
+*   - id 0 is the end marker "$" (only used by the LR tables)
+*   - ids 1..T are the terminals, sorted by character
+*   - the remaining ids are the nonterminals, the augmented start last
+*
+* Rule 0 is always the augmented rule S' -> S. Rule bodies are
+* stored back to back in one array, and rules are indexed by head,
+* so the parsers never touch a std::string while parsing.
+**************************************************/
+
+#ifndef GRAMMARINDEX_H
+#define GRAMMARINDEX_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CFG.h"
+
+class BinaryGrammar;
+
+using SymbolId = int32_t;
+constexpr SymbolId NoSymbol = -1;
+
+// A read-only view on a contiguous run of ids (C++17 has no std::span).
+template <typename T>
+struct IdRange {
+ const T *first = nullptr;
+ const T *last = nullptr;
+
+ const T *begin() const { return first; }
+ const T *end() const { return last; }
+ size_t size() const { return size_t(last - first); }
+ bool empty() const { return first == last; }
+ const T &operator[](size_t i) const { return first[i]; }
+};
+
+class GrammarIndex {
+public:
+ explicit GrammarIndex(const CFG &cfg);
+ // Same ids and rules as GrammarIndex(CFG) of the grammar it was written from
+ explicit GrammarIndex(const BinaryGrammar &binary);
+
+ // ---- Symbols ----
+ size_t symbolCount() const { return names.size(); }
+ size_t terminalCount() const { return numTerminals; } // includes "$"
+ size_t nonTerminalCount() const { return names.size() - numTerminals; }
+
+ bool isTerminal(SymbolId s) const { return kinds[s] == Terminal; }
+ bool isNonTerminal(SymbolId s) const { return kinds[s] == NonTerminal; }
+
+ // Position of a nonterminal in [0, nonTerminalCount()), for bitsets/tables
+ size_t nonTerminalIndex(SymbolId s) const { return size_t(s) - numTerminals; }
+ SymbolId nonTerminalAt(size_t idx) const { return SymbolId(idx + numTerminals); }
+
+ const std::string &symbolName(SymbolId s) const { return names[s]; }
+ SymbolId findSymbol(const std::string &name) const;
+
+ // Terminal id for an input character, or NoSymbol if it is not a terminal
+ SymbolId terminalFor(char c) const { return charToTerminal[(unsigned char)c]; }
+ char terminalChar(SymbolId s) const { return names[s][0]; }
+
+ SymbolId endMarker() const { return 0; }
+ SymbolId startSymbol() const { return start; }
+ SymbolId augmentedStart() const { return augmented; }
+
+ // ---- Rules ----
+ size_t ruleCount() const { return heads.size(); }
+ SymbolId ruleHead(int rule) const { return heads[rule]; }
+ IdRange<SymbolId> ruleBody(int rule) const {
+   return {bodySymbols.data() + bodyOffsets[rule], bodySymbols.data() + bodyOffsets[rule + 1]};
+ }
+ size_t ruleLength(int rule) const { return bodyOffsets[rule + 1] - bodyOffsets[rule]; }
+
+ // All rules with the given nonterminal as head
+ IdRange<int> rulesFor(SymbolId nt) const {
+   size_t idx = nonTerminalIndex(nt);
+   return {headRules.data() + headOffsets[idx], headRules.data() + headOffsets[idx + 1]};
+ }
+
+ // "A -> a•B" style rendering, dot < 0 means no dot
+ std::string ruleToString(int rule, int dot = -1) const;
+
+ // ---- Dotted rules ----
+ // Every (rule, dot) pair has its own id; the ids of one rule are
+ // consecutive, so moving the dot right is just "+1".
+ size_t dottedRuleCount() const { return dottedRule.size(); }
+ uint32_t dotted(int rule, size_t dot) const { return bodyOffsets[rule] + (uint32_t)rule + (uint32_t)dot; }
+ int dottedRuleOf(uint32_t d) const { return dottedRule[d]; }
+ size_t dottedDotOf(uint32_t d) const { return d - dotted(dottedRule[d], 0); }
+ // Symbol right after the dot, NoSymbol when the dot is at the end
+ SymbolId symbolAfterDot(uint32_t d) const { return afterDot[d]; }
+ bool isCompleted(uint32_t d) const { return afterDot[d] == NoSymbol; }
+
+ // ---- Analyses ----
+ // A nonterminal is nullable if it derives the empty string
+ bool isNullable(SymbolId s) const { return nullable[s] != 0; }
+
+private:
+ enum Kind : uint8_t { Terminal, NonTerminal };
+
+ std::vector<std::string> names;
+ std::vector<uint8_t> kinds;           // flat classification table
+ std::unordered_map<std::string, SymbolId> ids;
+ std::array<SymbolId, 256> charToTerminal{};
+ size_t numTerminals = 0;
+ SymbolId start = NoSymbol;
+ SymbolId augmented = NoSymbol;
+
+ std::vector<SymbolId> heads;          // heads[rule]
+ std::vector<uint32_t> bodyOffsets;    // body of rule r is [bodyOffsets[r], bodyOffsets[r+1])
+ std::vector<SymbolId> bodySymbols;
+
+ std::vector<uint32_t> headOffsets;    // CSR index: nonterminal index -> rules
+ std::vector<int> headRules;
+
+ std::vector<int> dottedRule;          // dotted rule id -> rule
+ std::vector<SymbolId> afterDot;       // dotted rule id -> next symbol
+
+ std::vector<uint8_t> nullable;        // per symbol
+
+ void addAugmentedRule();
+ void indexRules();
+ void computeNullable();
+
+ SymbolId intern(const std::string &name, Kind kind);
+};
+
+#endif // GRAMMARINDEX_H
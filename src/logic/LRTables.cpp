@@ -0,0 +1,402 @@
+#include "LRTables.h"
+#include <unordered_map>
+
+namespace {
+
+// Builds the automaton of one grammar; the states, FIRST sets and
+// closure templates are only needed while building and are dropped
+// with the builder.
+class LRTableBuilder {
+public:
+  LRTableBuilder(const GrammarIndex &grammar, LRTableKind kind) : grammar(grammar), tableKind(kind) {}
+
+  LRTables build() {
+    buildAutomaton();  // Build the LALR(1) or LR(1) states
+    buildTables();     // Create SHIFT/REDUCE/ACCEPT actions
+
+    LRTables tables;
+    tables.kind = tableKind;
+    tables.stateCount = states.size();
+    tables.terminalCount = grammar.terminalCount();
+    tables.nonTerminalCount = grammar.nonTerminalCount();
+    auto arrays = std::make_shared<Arrays>();
+    arrays->actionStart = std::move(actionStart);
+    arrays->actions = std::move(actions);
+    arrays->gotoTable = std::move(gotoTable);
+    tables.actionStart = { arrays->actionStart.data(), arrays->actionStart.data() + arrays->actionStart.size() };
+    tables.actions = { arrays->actions.data(), arrays->actions.data() + arrays->actions.size() };
+    tables.gotoTable = { arrays->gotoTable.data(), arrays->gotoTable.data() + arrays->gotoTable.size() };
+    tables.storage = std::move(arrays);
+    return tables;
+  }
+
+private:
+  const GrammarIndex &grammar;
+  LRTableKind tableKind;
+  // The tables as built, see LRTables
+  struct Arrays {
+    std::vector<uint32_t> actionStart;
+    std::vector<LRAction> actions;
+    std::vector<int32_t> gotoTable;
+  };
+  std::vector<uint32_t> actionStart;
+  std::vector<LRAction> actions;
+  std::vector<int32_t> gotoTable;
+  std::vector<LRState> states;             // all automaton states
+  std::vector<LRTransition> transitions;   // grouped by `from`
+  std::vector<LookaheadSet> first;         // FIRST set per symbol
+
+  void computeFirstSets();
+  LookaheadSet firstAfter(int rule, size_t from, const LookaheadSet &follow) const;
+  // Closure of one prediction, memoized per nonterminal B: the items
+  // [C -> •γ] that predicting B adds, with the lookaheads they get
+  // regardless of context (`spontaneous`) and whether the lookaheads of
+  // the predicting item flow into them too (`propagates`).
+  struct ClosureEntry {
+    int ruleId;
+    LookaheadSet spontaneous;
+    bool propagates;
+  };
+  std::vector<std::vector<ClosureEntry>> closureTemplates; // by nonterminal index
+  std::vector<uint8_t> hasClosureTemplate;
+  const std::vector<ClosureEntry> &closureTemplate(SymbolId B);
+
+  // States by kernel hash (hash-consing)
+  std::unordered_map<uint64_t, std::vector<int>> statesByKernel;
+  // Scratch: position of a dotted rule in the state being closed and of
+  // a rule in the template being built, -1 if absent
+  std::vector<int32_t> itemSlot;
+  std::vector<int32_t> ruleSlot;
+
+  void closeState(LRState &st);
+  uint64_t hashKernel(const LRState &st) const;
+  bool sameKernel(const LRState &a, const LRState &b) const;
+  int findOrAddState(LRState &&kernel, bool &added);
+  void buildAutomaton();
+  void buildTables();
+  bool nullableFrom(int rule, size_t from) const;
+};
+
+// FIRST sets by fixpoint over the rules. first[t] = {t} for a terminal,
+// so FIRST of a sentential form can be read off symbol by symbol.
+void LRTableBuilder::computeFirstSets() {
+  first.assign(grammar.symbolCount(), LookaheadSet{});
+  for (SymbolId t = 0; t < (SymbolId)grammar.terminalCount(); t++) {
+    first[t].insert(t);
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int r = 0; r < (int)grammar.ruleCount(); r++) {
+      SymbolId head = grammar.ruleHead(r);
+      for (SymbolId sym : grammar.ruleBody(r)) {
+        if (sym != head && first[head].merge(first[sym])) changed = true;
+        if (!grammar.isNullable(sym)) break;
+      }
+    }
+  }
+}
+
+// FIRST(β L), where β is the part of `rule` from position `from` on
+LookaheadSet LRTableBuilder::firstAfter(int rule, size_t from, const LookaheadSet &follow) const {
+  LookaheadSet out;
+  IdRange<SymbolId> body = grammar.ruleBody(rule);
+  for (size_t i = from; i < body.size(); i++) {
+    out.merge(first[body[i]]);
+    if (!grammar.isNullable(body[i])) return out;
+  }
+  out.merge(follow);
+  return out;
+}
+
+// Closure of [X -> α•Bβ, {#}], where the marker # (one past the last
+// terminal) stands for FIRST(β L) of whichever item predicts B. Once
+// computed, closing a state costs one pass over these entries per
+// kernel item instead of a fixpoint over the whole grammar.
+const std::vector<LRTableBuilder::ClosureEntry> &LRTableBuilder::closureTemplate(SymbolId B) {
+  size_t b = grammar.nonTerminalIndex(B);
+  if (hasClosureTemplate[b]) return closureTemplates[b];
+
+  const SymbolId marker = (SymbolId)grammar.terminalCount();
+  LookaheadSet markerOnly;
+  markerOnly.insert(marker);
+
+  std::vector<int> rules;
+  std::vector<LookaheadSet> las;
+  std::vector<size_t> work;
+  auto add = [&](int r, const LookaheadSet &la) {
+    if (ruleSlot[r] < 0) {
+      ruleSlot[r] = (int32_t)rules.size();
+      rules.push_back(r);
+      las.push_back(la);
+      work.push_back(rules.size() - 1);
+    } else if (las[ruleSlot[r]].merge(la)) {
+      work.push_back(ruleSlot[r]);
+    }
+  };
+
+  for (int r : grammar.rulesFor(B)) add(r, markerOnly);
+  while (!work.empty()) {
+    size_t i = work.back();
+    work.pop_back();
+    IdRange<SymbolId> body = grammar.ruleBody(rules[i]);
+    if (body.empty() || !grammar.isNonTerminal(body[0])) continue;
+    LookaheadSet la = firstAfter(rules[i], 1, las[i]);
+    for (int r : grammar.rulesFor(body[0])) add(r, la);
+  }
+
+  std::vector<ClosureEntry> &out = closureTemplates[b];
+  for (size_t i = 0; i < rules.size(); i++) {
+    ruleSlot[rules[i]] = -1;
+    bool propagates = las[i].contains(marker);
+    las[i].erase(marker);
+    out.push_back(ClosureEntry{ rules[i], std::move(las[i]), propagates });
+  }
+  hasClosureTemplate[b] = 1;
+  return out;
+}
+
+// Rebuilds the closure part of `st` from its kernel
+void LRTableBuilder::closeState(LRState &st) {
+  st.items.resize(st.kernelSize);
+  st.lookaheads.resize(st.kernelSize);
+  for (size_t k = 0; k < st.kernelSize; k++) {
+    itemSlot[grammar.dotted(st.items[k].ruleId, st.items[k].dotPos)] = (int32_t)k;
+  }
+
+  for (size_t k = 0; k < st.kernelSize; k++) {
+    LRItem item = st.items[k];
+    IdRange<SymbolId> body = grammar.ruleBody(item.ruleId);
+    if (item.dotPos >= body.size() || !grammar.isNonTerminal(body[item.dotPos])) continue;
+
+    LookaheadSet tail = firstAfter(item.ruleId, item.dotPos + 1, st.lookaheads[k]);
+    for (const ClosureEntry &e : closureTemplate(body[item.dotPos])) {
+      uint32_t d = grammar.dotted(e.ruleId, 0);
+      if (itemSlot[d] < 0) {
+        itemSlot[d] = (int32_t)st.items.size();
+        st.items.push_back(LRItem{ e.ruleId, 0 });
+        st.lookaheads.emplace_back();
+      }
+      LookaheadSet &la = st.lookaheads[itemSlot[d]];
+      la.merge(e.spontaneous);
+      if (e.propagates) la.merge(tail);
+    }
+  }
+
+  for (const LRItem &item : st.items) {
+    itemSlot[grammar.dotted(item.ruleId, item.dotPos)] = -1;
+  }
+}
+
+inline uint64_t mixHash(uint64_t h, uint64_t v) {
+  h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  return h;
+}
+
+// LALR(1) identifies states by their kernel core, canonical LR(1) by
+// the kernel including its lookaheads
+uint64_t LRTableBuilder::hashKernel(const LRState &st) const {
+  uint64_t h = st.kernelSize;
+  for (size_t k = 0; k < st.kernelSize; k++) {
+    h = mixHash(h, grammar.dotted(st.items[k].ruleId, st.items[k].dotPos));
+    if (tableKind == LRTableKind::LR1) {
+      for (uint64_t w : st.lookaheads[k].bits) {
+        if (w) h = mixHash(h, w);
+      }
+    }
+  }
+  return h;
+}
+
+bool LRTableBuilder::sameKernel(const LRState &a, const LRState &b) const {
+  if (a.kernelSize != b.kernelSize) return false;
+  for (size_t k = 0; k < a.kernelSize; k++) {
+    if (!(a.items[k] == b.items[k])) return false;
+    if (tableKind == LRTableKind::LR1 && !(a.lookaheads[k] == b.lookaheads[k])) return false;
+  }
+  return true;
+}
+
+// `kernel` holds only kernel items, sorted. Returns the existing state
+// with that kernel, or closes and adds it.
+int LRTableBuilder::findOrAddState(LRState &&kernel, bool &added) {
+  kernel.kernelHash = hashKernel(kernel);
+  std::vector<int> &bucket = statesByKernel[kernel.kernelHash];
+  for (int idx : bucket) {
+    if (sameKernel(states[idx], kernel)) {
+      added = false;
+      return idx;
+    }
+  }
+  closeState(kernel);
+  states.push_back(std::move(kernel));
+  bucket.push_back((int)states.size() - 1);
+  added = true;
+  return (int)states.size() - 1;
+}
+
+void LRTableBuilder::buildAutomaton() {
+  computeFirstSets();
+  closureTemplates.assign(grammar.nonTerminalCount(), {});
+  hasClosureTemplate.assign(grammar.nonTerminalCount(), 0);
+  itemSlot.assign(grammar.dottedRuleCount(), -1);
+  ruleSlot.assign(grammar.ruleCount(), -1);
+  states.clear();
+  transitions.clear();
+  statesByKernel.clear();
+
+  // Initial state: closure of [S' -> •S, {$}]
+  LRState I0;
+  I0.items.push_back(LRItem{ 0, 0 });
+  I0.lookaheads.emplace_back();
+  I0.lookaheads[0].insert(grammar.endMarker());
+  I0.kernelSize = 1;
+  bool added;
+  findOrAddState(std::move(I0), added);
+
+  // 1) Expand every state once, in creation order, so transitions end up
+  //    grouped by their source state. Items are bucketed by the symbol
+  //    after their dot; each bucket advanced is a successor kernel.
+  std::vector<uint8_t> dirty;
+  std::vector<int> dirtyList;
+  std::vector<std::vector<uint32_t>> bySymbol(grammar.symbolCount());
+  std::vector<SymbolId> touched;
+  std::vector<uint32_t> transitionStart;
+
+  for (int s = 0; s < (int)states.size(); s++) {
+    transitionStart.push_back((uint32_t)transitions.size());
+    touched.clear();
+    for (uint32_t i = 0; i < states[s].items.size(); i++) {
+      const LRItem &item = states[s].items[i];
+      IdRange<SymbolId> body = grammar.ruleBody(item.ruleId);
+      if (item.dotPos >= body.size()) continue;
+      SymbolId X = body[item.dotPos];
+      if (bySymbol[X].empty()) touched.push_back(X);
+      bySymbol[X].push_back(i);
+    }
+    std::sort(touched.begin(), touched.end());
+
+    for (SymbolId X : touched) {
+      std::vector<uint32_t> &bucket = bySymbol[X];
+      std::sort(bucket.begin(), bucket.end(), [&](uint32_t a, uint32_t b) {
+        return states[s].items[a] < states[s].items[b];
+      });
+      LRState kernel;
+      for (uint32_t i : bucket) {
+        kernel.items.push_back(LRItem{ states[s].items[i].ruleId, states[s].items[i].dotPos + 1 });
+        kernel.lookaheads.push_back(states[s].lookaheads[i]);
+      }
+      kernel.kernelSize = kernel.items.size();
+      bucket.clear();
+
+      LRState incoming = tableKind == LRTableKind::LALR1 ? kernel : LRState{};
+      int t = findOrAddState(std::move(kernel), added);
+      if (!added && tableKind == LRTableKind::LALR1) {
+        // Same core: merge the lookaheads, to be propagated below
+        bool changed = false;
+        for (size_t k = 0; k < incoming.kernelSize; k++) {
+          if (states[t].lookaheads[k].merge(incoming.lookaheads[k])) changed = true;
+        }
+        if (changed) {
+          if (dirty.size() <= (size_t)t) dirty.resize(t + 1, 0);
+          if (!dirty[t]) { dirty[t] = 1; dirtyList.push_back(t); }
+        }
+      }
+      transitions.push_back(LRTransition{ s, X, t });
+    }
+  }
+  transitionStart.push_back((uint32_t)transitions.size());
+
+  // 2) LALR: push grown lookaheads along the transitions until nothing
+  //    changes. The cores are fixed now, only lookahead bits move.
+  dirty.resize(states.size(), 0);
+  while (!dirtyList.empty()) {
+    int s = dirtyList.back();
+    dirtyList.pop_back();
+    dirty[s] = 0;
+    closeState(states[s]);
+
+    for (uint32_t e = transitionStart[s]; e < transitionStart[s + 1]; e++) {
+      LRState &target = states[transitions[e].to];
+      bool changed = false;
+      for (size_t i = 0; i < states[s].items.size(); i++) {
+        const LRItem &item = states[s].items[i];
+        IdRange<SymbolId> body = grammar.ruleBody(item.ruleId);
+        if (item.dotPos >= body.size() || body[item.dotPos] != transitions[e].symbol) continue;
+        LRItem advanced{ item.ruleId, item.dotPos + 1 };
+        auto kernelEnd = target.items.begin() + target.kernelSize;
+        auto it = std::lower_bound(target.items.begin(), kernelEnd, advanced);
+        if (target.lookaheads[it - target.items.begin()].merge(states[s].lookaheads[i])) changed = true;
+      }
+      int t = transitions[e].to;
+      if (changed && !dirty[t]) {
+        dirty[t] = 1;
+        dirtyList.push_back(t);
+      }
+    }
+  }
+}
+
+void LRTableBuilder::buildTables() {
+  const size_t T = grammar.terminalCount();
+  const size_t N = grammar.nonTerminalCount();
+
+  // Collect every action per cell first; conflicts keep all of them
+  std::vector<std::vector<LRAction>> cells(states.size() * T);
+  gotoTable.assign(states.size() * N, -1);
+
+  // SHIFT on terminal transitions, GOTO on nonterminal ones
+  for (const LRTransition &tr : transitions) {
+    if (grammar.isTerminal(tr.symbol)) {
+      cells[tr.from * T + tr.symbol].push_back(LRAction{ ActionType::Shift, tr.to });
+    } else {
+      gotoTable[tr.from * N + grammar.nonTerminalIndex(tr.symbol)] = tr.to;
+    }
+  }
+
+  // REDUCE on the lookaheads of every item A -> α•β with a nullable β
+  // (right-nulled reduction by |α|; β is empty for completed items)
+  for (int i = 0; i < (int)states.size(); i++) {
+    for (size_t k = 0; k < states[i].items.size(); k++) {
+      const LRItem &item = states[i].items[k];
+      const LookaheadSet &la = states[i].lookaheads[k];
+      if (item.ruleId == 0) {
+        // S' -> S• : ACCEPT on '$'
+        if (item.dotPos == grammar.ruleLength(0)) {
+          cells[i * T + grammar.endMarker()].push_back(LRAction{ ActionType::Accept, -1 });
+        }
+        continue;
+      }
+      if (!nullableFrom(item.ruleId, item.dotPos)) continue;
+      for (SymbolId t = 0; t < (SymbolId)T; t++) {
+        if (la.contains(t)) {
+          cells[i * T + t].push_back(LRAction{ ActionType::Reduce, item.ruleId, (int)item.dotPos });
+        }
+      }
+    }
+  }
+
+  // Pack the cells into one array (CSR): cell c owns
+  // actions[actionStart[c] .. actionStart[c+1])
+  actions.clear();
+  actionStart.assign(cells.size() + 1, 0);
+  for (size_t c = 0; c < cells.size(); c++) {
+    actions.insert(actions.end(), cells[c].begin(), cells[c].end());
+    actionStart[c + 1] = (uint32_t)actions.size();
+  }
+}
+
+// True if the part of `rule` from position `from` on derives ε
+bool LRTableBuilder::nullableFrom(int rule, size_t from) const {
+  IdRange<SymbolId> body = grammar.ruleBody(rule);
+  for (size_t i = from; i < body.size(); i++) {
+    if (!grammar.isNullable(body[i])) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+LRTables LRTables::build(const GrammarIndex &grammar, LRTableKind kind) {
+  return LRTableBuilder(grammar, kind).build();
+}
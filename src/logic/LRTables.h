@@ -0,0 +1,155 @@
+/**************************************************
+* LRTables.h - LR(1)/LALR(1) automaton and its ACTION/GOTO tables
+*
+* Usage:
+*   LRTables tables = LRTables::build(grammar, LRTableKind::LALR1);
+*   for (const LRAction &act : tables.actionsFor(state, terminal)) { ... }
+*
+* build() constructs the automaton (hash-consed kernels, memoized
+* closures, LALR lookahead propagation) and keeps only what a parser
+* needs at run time: the dense tables. They are plain arrays, so a
+* CompiledGrammar can share one LRTables between any number of parsers,
+* and GrammarCache can serve them straight from a mapped .cfgc file.
+**************************************************/
+
+#ifndef LRTABLES_H
+#define LRTABLES_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "GrammarIndex.h"
+
+// Production rules live in the GrammarIndex (rule 0 = S' -> S),
+// bodies are contiguous arrays of SymbolIds.
+
+// LR(0) item: rule # plus dot position
+// Example:  (ruleId=2, dotPos=1) means: for the rule #2 "S->a b",
+// the dot is after the first symbol.
+struct LRItem {
+ int ruleId;     // which rule
+ size_t dotPos;  // dot position in that rule's RHS
+
+ bool operator<(const LRItem &o) const {
+   if (ruleId != o.ruleId) return ruleId < o.ruleId;
+   return dotPos < o.dotPos;
+ }
+ bool operator==(const LRItem &o) const {
+   return (ruleId == o.ruleId && dotPos == o.dotPos);
+ }
+};
+
+// Set of terminal ids, bit t = terminal t ("$" is 0)
+struct LookaheadSet {
+ std::vector<uint64_t> bits;
+
+ bool contains(SymbolId t) const {
+   size_t w = (size_t)t >> 6;
+   return w < bits.size() && ((bits[w] >> (t & 63)) & 1);
+ }
+ // true if t was not in the set yet
+ bool insert(SymbolId t) {
+   size_t w = (size_t)t >> 6;
+   if (w >= bits.size()) bits.resize(w + 1, 0);
+   uint64_t bit = uint64_t(1) << (t & 63);
+   if (bits[w] & bit) return false;
+   bits[w] |= bit;
+   return true;
+ }
+ void erase(SymbolId t) {
+   size_t w = (size_t)t >> 6;
+   if (w < bits.size()) bits[w] &= ~(uint64_t(1) << (t & 63));
+ }
+ // true if anything was added
+ bool merge(const LookaheadSet &o) {
+   if (o.bits.size() > bits.size()) bits.resize(o.bits.size(), 0);
+   bool changed = false;
+   for (size_t i = 0; i < o.bits.size(); i++) {
+     uint64_t merged = bits[i] | o.bits[i];
+     if (merged != bits[i]) { bits[i] = merged; changed = true; }
+   }
+   return changed;
+ }
+ bool operator==(const LookaheadSet &o) const {
+   size_t n = std::max(bits.size(), o.bits.size());
+   for (size_t i = 0; i < n; i++) {
+     uint64_t a = i < bits.size() ? bits[i] : 0;
+     uint64_t b = i < o.bits.size() ? o.bits[i] : 0;
+     if (a != b) return false;
+   }
+   return true;
+ }
+};
+
+// One LR(1) state: its kernel items followed by their closure, each
+// with the terminals it may be reduced on. The closure items (dot 0)
+// are derived from the kernel, so the kernel alone identifies a state.
+struct LRState {
+ std::vector<LRItem> items;
+ std::vector<LookaheadSet> lookaheads; // parallel to items
+ size_t kernelSize = 0;
+ uint64_t kernelHash = 0;
+};
+
+// GOTO/SHIFT edge of the automaton
+struct LRTransition {
+ int from;
+ SymbolId symbol;
+ int to;
+};
+
+// Which automaton the tables are built from. LALR(1) merges states with
+// the same core and is much smaller; canonical LR(1) keeps them apart,
+// which can remove reduce/reduce conflicts LALR merging introduces.
+enum class LRTableKind { LALR1, LR1 };
+
+// Parser actions:
+enum class ActionType { Shift, Reduce, Accept, Error };
+
+struct LRAction {
+ ActionType type;
+ int stateOrRule; // SHIFT -> new state, REDUCE -> which rule, ACCEPT -> -1
+ int length = 0;  // REDUCE: symbols popped (less than the rule length if right-nulled)
+};
+static_assert(std::is_trivially_copyable<LRAction>::value, "LRAction is stored in .cfgc files as is");
+
+// ACTION and GOTO of an automaton, nothing else
+struct LRTables {
+ LRTableKind kind = LRTableKind::LALR1;
+ size_t stateCount = 0;
+ size_t terminalCount = 0;     // ACTION columns
+ size_t nonTerminalCount = 0;  // GOTO columns
+ // ACTION: dense (state, terminal) cells, each a range of the packed
+ // action list, so shift/reduce and reduce/reduce conflicts keep
+ // every action: cell c = actions[actionStart[c] .. actionStart[c+1])
+ IdRange<uint32_t> actionStart;
+ IdRange<LRAction> actions;
+ // GOTO: dense (state, nonterminal index) -> newState, -1 if none
+ IdRange<int32_t> gotoTable;
+ // Keeps the arrays above alive: the vectors of a build, or a mapping
+ std::shared_ptr<const void> storage;
+
+ static LRTables build(const GrammarIndex &grammar, LRTableKind kind);
+
+ // Table lookups (one array index each)
+ IdRange<LRAction> actionsFor(int state, SymbolId terminal) const {
+   // characters that are not terminals have no actions at all
+   if (terminal == NoSymbol) return {};
+   size_t c = (size_t)state * terminalCount + terminal;
+   return { actions.begin() + actionStart[c], actions.begin() + actionStart[c + 1] };
+ }
+ int gotoState(int state, size_t nonTerminalIndex) const {
+   return gotoTable[(size_t)state * nonTerminalCount + nonTerminalIndex];
+ }
+ bool canAccept(int state, SymbolId endMarker) const {
+   for (const LRAction &act : actionsFor(state, endMarker)) {
+     if (act.type == ActionType::Accept) return true;
+   }
+   return false;
+ }
+};
+
+#endif // LRTABLES_H
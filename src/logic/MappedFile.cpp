@@ -0,0 +1,38 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string &path) {
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return;
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      bytes = static_cast<const char *>(p);
+      length = (size_t)st.st_size;
+    }
+  }
+  ::close(fd);
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return;
+  copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  bytes = copy.data();
+  length = copy.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (bytes) ::munmap(const_cast<char *>(bytes), length);
+#endif
+}
@@ -0,0 +1,39 @@
+/**************************************************
+* MappedFile.h - Read-only view of a whole file
+*
+* Usage:
+*   auto file = std::make_shared<MappedFile>("tables.cfgc");
+*   if (file->size() >= sizeof(Header)) { ... file->data() ... }
+*
+* mmap where there is one, a heap copy otherwise. A missing or empty
+* file gives size() == 0. The binary formats (GrammarCache's .cfgc,
+* BinaryGrammar's .cfgb) keep a shared_ptr to the file so the views
+* into it outlive the loader.
+**************************************************/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MappedFile {
+public:
+ explicit MappedFile(const std::string &path);
+ ~MappedFile();
+ MappedFile(const MappedFile &) = delete;
+ MappedFile &operator=(const MappedFile &) = delete;
+
+ const char *data() const { return bytes; }
+ size_t size() const { return length; }
+
+private:
+ const char *bytes = nullptr;
+ size_t length = 0;
+#ifdef _WIN32
+ std::vector<char> copy;
+#endif
+};
+
+#endif // MAPPEDFILE_H
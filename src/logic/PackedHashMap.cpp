@@ -0,0 +1,71 @@
+#include "PackedHashMap.h"
+
+/**************************************************
+ * Hash map (open addressing, linear probing)
+ **************************************************/
+
+// 64-bit finalizer (murmur3 fmix) so dense ids spread over the table
+static inline uint64_t mixKey(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+void PackedHashMap::clear() {
+  // Bumping the generation invalidates every slot at once
+  count = 0;
+  if (++generation == 0) {
+    for (auto &slot : slots) slot.generation = 0;
+    generation = 1;
+  }
+}
+
+uint32_t &PackedHashMap::findOrInsert(uint64_t key, uint32_t init, bool &inserted) {
+  // keep the load factor under 1/2
+  if ((count + 1) * 2 > slots.size()) grow();
+
+  size_t mask = slots.size() - 1;
+  for (size_t i = mixKey(key) & mask;; i = (i + 1) & mask) {
+    Slot &slot = slots[i];
+    if (slot.generation != generation) {
+      slot.key = key;
+      slot.value = init;
+      slot.generation = generation;
+      count++;
+      inserted = true;
+      return slot.value;
+    }
+    if (slot.key == key) {
+      inserted = false;
+      return slot.value;
+    }
+  }
+}
+
+const uint32_t *PackedHashMap::find(uint64_t key) const {
+  if (slots.empty()) return nullptr;
+  size_t mask = slots.size() - 1;
+  for (size_t i = mixKey(key) & mask;; i = (i + 1) & mask) {
+    const Slot &slot = slots[i];
+    if (slot.generation != generation) return nullptr;
+    if (slot.key == key) return &slot.value;
+  }
+}
+
+void PackedHashMap::grow() {
+  std::vector<Slot> old;
+  old.swap(slots);
+  uint32_t oldGeneration = generation;
+  slots.assign(old.empty() ? 64 : old.size() * 2, Slot{0, 0, 0});
+  generation = 1;
+  count = 0;
+  bool inserted;
+  for (auto &slot : old) {
+    if (slot.generation == oldGeneration) {
+      findOrInsert(slot.key, slot.value, inserted);
+    }
+  }
+}
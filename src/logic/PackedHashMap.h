@@ -0,0 +1,40 @@
+/**************************************************
+* PackedHashMap.h - Small hash map for packed integer keys
+**************************************************/
+
+#ifndef PACKEDHASHMAP_H
+#define PACKEDHASHMAP_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Open-addressing hash map from packed 64-bit keys to 32-bit values
+// (keys are usually two 32-bit ids, e.g. (column << 32) | symbol).
+// The Earley parser uses it to dedupe the items of the column being
+// built and to find the items waiting on a nonterminal; the GLR parser
+// to dedupe the edges of a GSS level.
+// Slots are stamped with a generation number, so clear() is O(1).
+class PackedHashMap {
+public:
+ void clear();
+ // Returns the value stored for key; if the key is new it is inserted
+ // with value `init` and `inserted` is set.
+ uint32_t &findOrInsert(uint64_t key, uint32_t init, bool &inserted);
+ // Returns the value stored for key, or nullptr
+ const uint32_t *find(uint64_t key) const;
+
+private:
+ struct Slot {
+   uint64_t key;
+   uint32_t value;
+   uint32_t generation;
+ };
+ std::vector<Slot> slots;
+ uint32_t generation = 1;
+ size_t count = 0;
+
+ void grow();
+};
+
+#endif // PACKEDHASHMAP_H
@@ -0,0 +1,222 @@
+#include "ParseForest.h"
+#include <algorithm>
+
+/**************************************************
+ * Building
+ **************************************************/
+
+void ParseForest::clear() {
+  nodes.clear();
+  families.clear();
+  rootNode = NoNode;
+}
+
+SPPFNodeId ParseForest::addNode(SPPFKind kind, int32_t label, uint32_t start, uint32_t end) {
+  nodes.push_back(SPPFNode{kind, label, start, end, NoNode});
+  return (SPPFNodeId)nodes.size() - 1;
+}
+
+// The parser guarantees a family is only added once per node
+void ParseForest::addFamily(SPPFNodeId node, uint32_t dottedRule, SPPFNodeId left, SPPFNodeId right) {
+  families.push_back(SPPFFamily{dottedRule, left, right, nodes[node].firstFamily});
+  nodes[node].firstFamily = (uint32_t)families.size() - 1;
+}
+
+/**************************************************
+ * Walking
+ **************************************************/
+
+std::vector<SPPFNodeId> ParseForest::familyChildren(const SPPFFamily &fam) const {
+  std::vector<SPPFNodeId> children;
+  if (fam.right != NoNode) children.push_back(fam.right);
+
+  SPPFNodeId left = fam.left;
+  while (left != NoNode) {
+    const SPPFNode &n = nodes[left];
+    if (n.kind != SPPFKind::Intermediate) {
+      // a single symbol: the first child of the rule
+      children.push_back(left);
+      break;
+    }
+    const SPPFFamily &inner = families[n.firstFamily];
+    children.push_back(inner.right);
+    left = inner.left;
+  }
+
+  std::reverse(children.begin(), children.end());
+  return children;
+}
+
+std::string ParseForest::nodeLabel(SPPFNodeId id, const GrammarIndex &grammar) const {
+  const SPPFNode &n = nodes[id];
+  std::string name;
+  if (n.kind == SPPFKind::Intermediate) {
+    name = grammar.ruleToString(grammar.dottedRuleOf(n.label), (int)grammar.dottedDotOf(n.label));
+  } else {
+    name = grammar.symbolName(n.label);
+  }
+  return name + "(" + std::to_string(n.start) + "," + std::to_string(n.end) + ")";
+}
+
+void ParseForest::writeDot(std::ostream &out, const GrammarIndex &grammar) const {
+  out << "digraph SPPF {\n";
+  if (rootNode == NoNode) {
+    out << "  empty [label=\"No parse forest\"];\n}\n";
+    return;
+  }
+
+  // Only the reachable part: the parser also creates nodes for items
+  // that never ended up in a complete parse.
+  std::vector<uint8_t> seen(nodes.size(), 0);
+  std::vector<SPPFNodeId> stack = {rootNode};
+  seen[rootNode] = 1;
+  while (!stack.empty()) {
+    SPPFNodeId id = stack.back();
+    stack.pop_back();
+    const SPPFNode &n = nodes[id];
+
+    const char *shape = n.kind == SPPFKind::Terminal ? "plaintext"
+                      : n.kind == SPPFKind::Symbol ? "ellipse" : "box";
+    out << "  n" << id << " [shape=" << shape << ", label=\"" << nodeLabel(id, grammar) << "\"];\n";
+
+    for (uint32_t f = n.firstFamily; f != NoNode; f = families[f].next) {
+      const SPPFFamily &fam = families[f];
+      // packed nodes are small dots under their parent
+      out << "  p" << f << " [shape=point];\n";
+      out << "  n" << id << " -> p" << f << ";\n";
+      for (SPPFNodeId child : {fam.left, fam.right}) {
+        if (child == NoNode) continue;
+        out << "  p" << f << " -> n" << child << ";\n";
+        if (!seen[child]) {
+          seen[child] = 1;
+          stack.push_back(child);
+        }
+      }
+    }
+  }
+  out << "}\n";
+}
+
+/**************************************************
+ * Counting
+ **************************************************/
+
+static uint64_t saturatingAdd(uint64_t a, uint64_t b, bool &saturated) {
+  if (a > UINT64_MAX - b) { saturated = true; return UINT64_MAX; }
+  return a + b;
+}
+
+static uint64_t saturatingMul(uint64_t a, uint64_t b, bool &saturated) {
+  if (a != 0 && b > UINT64_MAX / a) { saturated = true; return UINT64_MAX; }
+  return a * b;
+}
+
+TreeCount ParseForest::countTrees() const {
+  TreeCount result;
+  if (rootNode == NoNode) return result;
+
+  // Iterative post-order DFS (forests of long inputs are deep).
+  // Gray = on the current path, so meeting a gray node is a cycle.
+  enum : uint8_t { White, Gray, Black };
+  std::vector<uint8_t> color(nodes.size(), White);
+  std::vector<uint64_t> count(nodes.size(), 0);
+  std::vector<std::pair<SPPFNodeId, bool>> stack = {{rootNode, false}};
+
+  while (!stack.empty()) {
+    auto [id, expanded] = stack.back();
+    if (!expanded) {
+      if (color[id] == Black) { stack.pop_back(); continue; }
+      color[id] = Gray;
+      stack.back().second = true;
+      forEachFamily(id, [&](const SPPFFamily &fam) {
+        for (SPPFNodeId child : {fam.left, fam.right}) {
+          if (child == NoNode) continue;
+          if (color[child] == Gray) result.infinite = true;
+          else if (color[child] == White) stack.push_back({child, false});
+        }
+      });
+      continue;
+    }
+
+    stack.pop_back();
+    uint64_t total = nodes[id].kind == SPPFKind::Terminal ? 1 : 0;
+    forEachFamily(id, [&](const SPPFFamily &fam) {
+      // a child still on the path (cycle) contributes no finite trees
+      uint64_t left = fam.left == NoNode ? 1 : (color[fam.left] == Black ? count[fam.left] : 0);
+      uint64_t right = fam.right == NoNode ? 1 : (color[fam.right] == Black ? count[fam.right] : 0);
+      total = saturatingAdd(total, saturatingMul(left, right, result.saturated), result.saturated);
+    });
+    count[id] = total;
+    color[id] = Black;
+  }
+
+  result.count = count[rootNode];
+  return result;
+}
+
+/**************************************************
+ * Sample derivations
+ **************************************************/
+
+std::vector<std::vector<int>> ParseForest::sampleDerivations(size_t limit, const GrammarIndex &grammar) const {
+  if (rootNode == NoNode || limit == 0) return {};
+  SampleState st{limit, std::vector<uint8_t>(nodes.size(), 0), std::vector<uint8_t>(nodes.size(), 0),
+                 std::vector<Derivations>(nodes.size())};
+  bool cut = false;
+  return nodeDerivations(rootNode, grammar, st, cut);
+}
+
+// Leftmost derivations of a node, at most st.limit of them. Results are
+// memoized unless a cycle was cut somewhere below (then they depend on
+// the path we came from).
+ParseForest::Derivations ParseForest::nodeDerivations(SPPFNodeId id, const GrammarIndex &grammar,
+                                                      SampleState &st, bool &cut) const {
+  const SPPFNode &n = nodes[id];
+  if (n.kind == SPPFKind::Terminal) return {{}};
+  if (st.done[id]) return st.memo[id];
+  if (st.onPath[id]) { cut = true; return {}; } // don't unroll cycles
+
+  st.onPath[id] = 1;
+  bool cutBelow = false;
+  Derivations out;
+  forEachFamily(id, [&](const SPPFFamily &fam) {
+    if (out.size() >= st.limit) return;
+    for (auto &d : familyDerivations(fam, grammar, st, cutBelow)) {
+      if (out.size() >= st.limit) break;
+      if (n.kind == SPPFKind::Symbol) {
+        // a symbol node applies the family's rule first
+        d.insert(d.begin(), grammar.dottedRuleOf(fam.dottedRule));
+      }
+      out.push_back(std::move(d));
+    }
+  });
+  st.onPath[id] = 0;
+
+  if (cutBelow) {
+    cut = true;
+  } else {
+    st.done[id] = 1;
+    st.memo[id] = out;
+  }
+  return out;
+}
+
+// Derivations of the children of one family: all left-part derivations
+// combined with all derivations of the right child
+ParseForest::Derivations ParseForest::familyDerivations(const SPPFFamily &fam, const GrammarIndex &grammar,
+                                                        SampleState &st, bool &cut) const {
+  Derivations left = fam.left == NoNode ? Derivations{{}} : nodeDerivations(fam.left, grammar, st, cut);
+  if (left.empty()) return {};
+  Derivations right = fam.right == NoNode ? Derivations{{}} : nodeDerivations(fam.right, grammar, st, cut);
+
+  Derivations out;
+  for (auto &l : left) {
+    for (auto &r : right) {
+      if (out.size() >= st.limit) return out;
+      std::vector<int> d = l;
+      d.insert(d.end(), r.begin(), r.end());
+      out.push_back(std::move(d));
+    }
+  }
+  return out;
+}
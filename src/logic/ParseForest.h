@@ -0,0 +1,124 @@
+/**************************************************
+* ParseForest.h - Shared packed parse forest (SPPF)
+*
+* Usage:
+*   EarleyParser parser(cfg);
+*   parser.setBuildForest(true);
+*   if (parser.parse("abba")) {
+*     const ParseForest &f = parser.getForest();
+*     f.forEachFamily(f.root(), [&](const SPPFFamily &fam) { ... });
+*   }
+*
+* Node kinds (Scott, "SPPF-style parsing from Earley recognisers"):
+*   - Terminal:     (a, i, i+1)
+*   - Symbol:       (A, i, j), A derives input[i..j)
+*   - Intermediate: (A -> α•β, i, j), α derives input[i..j)
+* Every Symbol/Intermediate node has one or more packed children
+* ("families"), each one alternative derivation. A family has at most
+* two children: `left` (the prefix α minus its last symbol, as an
+* intermediate node or, for a single symbol, that symbol's node) and
+* `right` (the node of the last symbol of α). Nodes are shared between
+* all derivations, so the forest stays cubic in the input length even
+* when the number of trees is exponential.
+**************************************************/
+
+#ifndef PARSEFOREST_H
+#define PARSEFOREST_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "GrammarIndex.h"
+
+using SPPFNodeId = uint32_t;
+constexpr SPPFNodeId NoNode = UINT32_MAX;
+
+enum class SPPFKind : uint8_t { Terminal, Symbol, Intermediate };
+
+// Number of parse trees in a forest. Counts saturate instead of
+// overflowing; a cycle reachable from the root means infinitely many.
+struct TreeCount {
+ uint64_t count = 0;
+ bool saturated = false; // count is a lower bound
+ bool infinite = false;  // cyclic derivations (e.g. A -> A, A -> B, B -> A)
+};
+
+struct SPPFNode {
+ SPPFKind kind;
+ int32_t label;        // SymbolId (Terminal/Symbol) or dotted rule id (Intermediate)
+ uint32_t start;
+ uint32_t end;
+ uint32_t firstFamily; // index into the family list, NoNode if none
+};
+
+// A packed node: one way of deriving its parent
+struct SPPFFamily {
+ uint32_t dottedRule;  // rule and dot position reached by this derivation
+ SPPFNodeId left;      // NoNode if the prefix is empty
+ SPPFNodeId right;     // NoNode only for ε (dot at 0)
+ uint32_t next;        // next family of the same node, NoNode at the end
+};
+
+class ParseForest {
+public:
+ void clear();
+
+ // ---- Building (used by the parser) ----
+ SPPFNodeId addNode(SPPFKind kind, int32_t label, uint32_t start, uint32_t end);
+ void addFamily(SPPFNodeId node, uint32_t dottedRule, SPPFNodeId left, SPPFNodeId right);
+ void setRoot(SPPFNodeId node) { rootNode = node; }
+
+ // ---- Walking ----
+ bool empty() const { return rootNode == NoNode; }
+ SPPFNodeId root() const { return rootNode; }
+ size_t nodeCount() const { return nodes.size(); }
+ size_t familyCount() const { return families.size(); }
+ const SPPFNode &node(SPPFNodeId id) const { return nodes[id]; }
+ const SPPFFamily &family(uint32_t idx) const { return families[idx]; }
+
+ template <typename F>
+ void forEachFamily(SPPFNodeId id, F &&visit) const {
+   for (uint32_t f = nodes[id].firstFamily; f != NoNode; f = families[f].next) {
+     visit(families[f]);
+   }
+ }
+
+ // The children of one family as grammar symbols, left to right:
+ // intermediate nodes on the left spine are expanded, so for a family
+ // of A -> XYZ you get the nodes of X, Y and Z. An intermediate node
+ // with several families makes this ambiguous; the first one is used.
+ std::vector<SPPFNodeId> familyChildren(const SPPFFamily &fam) const;
+
+ // "S(0,3)", "S -> aB•C(0,2)", "a(2,3)"
+ std::string nodeLabel(SPPFNodeId id, const GrammarIndex &grammar) const;
+
+ // Graphviz rendering of the part of the forest reachable from root()
+ void writeDot(std::ostream &out, const GrammarIndex &grammar) const;
+
+ // Trees below root(), one pass over the reachable forest (linear in
+ // its size, so polynomial in the input length)
+ TreeCount countTrees() const;
+
+ // Up to `limit` distinct trees below root(), each as the rule ids of
+ // its leftmost derivation. Cyclic derivations are not unrolled.
+ std::vector<std::vector<int>> sampleDerivations(size_t limit, const GrammarIndex &grammar) const;
+
+private:
+ using Derivations = std::vector<std::vector<int>>;
+ struct SampleState {
+   size_t limit;
+   std::vector<uint8_t> onPath;
+   std::vector<uint8_t> done;  // memo valid (no cycle was cut below)
+   std::vector<Derivations> memo;
+ };
+ Derivations nodeDerivations(SPPFNodeId id, const GrammarIndex &grammar, SampleState &st, bool &cut) const;
+ Derivations familyDerivations(const SPPFFamily &fam, const GrammarIndex &grammar, SampleState &st, bool &cut) const;
+
+ std::vector<SPPFNode> nodes;
+ std::vector<SPPFFamily> families;
+ SPPFNodeId rootNode = NoNode;
+};
+
+#endif // PARSEFOREST_H
@@ -0,0 +1,27 @@
+#include "ParseSession.h"
+
+ParseSession::ParseSession(std::shared_ptr<const CompiledGrammar> grammar, ParseEngine engine, LRTableKind kind)
+    : grammar(std::move(grammar)), engine(engine) {
+  if (engine == ParseEngine::Earley) {
+    earleyParser.reset(new EarleyParser(this->grammar));
+  } else {
+    glrParser.reset(new GLRParser(this->grammar, kind));
+  }
+}
+
+bool ParseSession::parse(const std::string &input) {
+  return engine == ParseEngine::Earley ? earleyParser->parse(input) : glrParser->parse(input);
+}
+
+ParseCounters ParseSession::counters() const {
+  ParseCounters out;
+  if (engine == ParseEngine::Earley) {
+    out.items = earleyParser->getChart().itemCount;
+  } else {
+    out.shifts = glrParser->shiftCount();
+    out.reductions = glrParser->reduceCount();
+    out.gssNodes = glrParser->gssNodeCount();
+    out.gssEdges = glrParser->gssEdgeCount();
+  }
+  return out;
+}
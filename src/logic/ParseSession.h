@@ -0,0 +1,62 @@
+/**************************************************
+* ParseSession.h - One thread's parser on a shared CompiledGrammar
+*
+* Usage:
+*   auto grammar = CompiledGrammar::compile(cfg);  // once
+*   ParseSession session(grammar, ParseEngine::GLR); // per thread
+*   bool ok = session.parse("abba");
+*   ParseCounters work = session.counters();
+*
+* The grammar analysis and tables live in the CompiledGrammar; a
+* session only holds the chart or GSS of its engine, reused from parse
+* to parse. Sessions are cheap to create but not thread-safe: use one
+* per thread.
+**************************************************/
+
+#ifndef PARSESESSION_H
+#define PARSESESSION_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "CompiledGrammar.h"
+#include "EarleyParser.h"
+#include "GLRParser.h"
+
+enum class ParseEngine { Earley, GLR };
+
+// Work done by the last parse
+struct ParseCounters {
+ uint64_t items = 0;     // Earley chart items
+ uint64_t shifts = 0;    // GLR stack steps, fast path included
+ uint64_t reductions = 0;
+ uint64_t gssNodes = 0;  // GLR graph-structured stack (none on the fast path)
+ uint64_t gssEdges = 0;
+};
+
+class ParseSession {
+public:
+ explicit ParseSession(std::shared_ptr<const CompiledGrammar> grammar,
+                       ParseEngine engine = ParseEngine::Earley,
+                       LRTableKind kind = LRTableKind::LALR1);
+
+ bool parse(const std::string &input);
+ ParseCounters counters() const;
+
+ ParseEngine getEngine() const { return engine; }
+ const std::shared_ptr<const CompiledGrammar> &getCompiledGrammar() const { return grammar; }
+
+ // The engine itself, for stepping, tracing and forests (nullptr for
+ // the engine the session does not use)
+ EarleyParser *earley() { return earleyParser.get(); }
+ GLRParser *glr() { return glrParser.get(); }
+
+private:
+ std::shared_ptr<const CompiledGrammar> grammar;
+ ParseEngine engine;
+ std::unique_ptr<EarleyParser> earleyParser;
+ std::unique_ptr<GLRParser> glrParser;
+};
+
+#endif // PARSESESSION_H
@@ -0,0 +1,77 @@
+#include "ParseTrace.h"
+#include <sstream>
+
+/**************************************************
+ * Rendering
+ **************************************************/
+
+static std::string dottedToString(const GrammarIndex &grammar, uint32_t dottedRule) {
+  return grammar.ruleToString(grammar.dottedRuleOf(dottedRule), (int)grammar.dottedDotOf(dottedRule));
+}
+
+static std::string completedToString(const GrammarIndex &grammar, int rule) {
+  return grammar.ruleToString(rule, (int)grammar.ruleLength(rule));
+}
+
+std::string describeEvent(const TraceEvent &event, const GrammarIndex &grammar) {
+  std::ostringstream msg;
+  switch (event.kind) {
+  case TraceKind::EarleyReset:
+    msg << "EarleyParser reset: inserted augmented item "
+        << grammar.ruleToString(event.rule, 0) << " at chart[0].";
+    break;
+  case TraceKind::EarleyScan:
+    msg << "Earley: SCAN at pos=" << event.pos
+        << " with nextChar='" << (char)event.a << "'. ";
+    if (event.flag) {
+      msg << "Some items scanned -> chart[" << (event.pos + 1) << "] updated.";
+    } else {
+      msg << "No items matched terminal '" << (char)event.a << "'.";
+    }
+    break;
+  case TraceKind::EarleyPredict:
+    msg << "Earley: PREDICT at chart[" << event.pos << "]: "
+        << grammar.ruleToString(event.rule, 0);
+    break;
+  case TraceKind::EarleyComplete:
+    msg << "Earley: COMPLETE at chart[" << event.pos << "]: "
+        << completedToString(grammar, event.rule);
+    break;
+  case TraceKind::EarleyLeoComplete:
+    msg << "Earley: LEO COMPLETE at chart[" << event.pos << "]: "
+        << completedToString(grammar, event.rule)
+        << " => " << dottedToString(grammar, event.a)
+        << " (start=" << event.b << ")";
+    break;
+  case TraceKind::EarleyAdvance:
+    msg << "Earley: advanced to pos=" << event.pos
+        << " (nextChar='" << (char)event.a << "').";
+    break;
+  case TraceKind::EarleyEnd:
+    msg << "Earley: end of input. " << (event.flag ? "ACCEPTED" : "REJECTED");
+    break;
+  case TraceKind::GLRShift:
+    msg << "GLR: SHIFT from state " << event.a << " to state " << event.b;
+    break;
+  case TraceKind::GLRReduce:
+    msg << "GLR: REDUCE by rule " << event.rule << " (" << grammar.ruleToString(event.rule)
+        << "), goto state " << event.b;
+    break;
+  case TraceKind::GLRAccept:
+    msg << "GLR: Accepted at pos " << event.pos;
+    break;
+  case TraceKind::GLRReject:
+    msg << "GLR: No valid configurations at pos " << event.pos << ". Rejected.";
+    break;
+  }
+  return msg.str();
+}
+
+std::vector<std::string> TraceLog::render(const GrammarIndex &grammar) const {
+  std::vector<std::string> lines;
+  lines.reserve(events.size());
+  for (const auto &event : events) {
+    lines.push_back(describeEvent(event, grammar));
+  }
+  return lines;
+}
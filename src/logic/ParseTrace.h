@@ -0,0 +1,86 @@
+/**************************************************
+* ParseTrace.h - Structured, opt-in tracing for the parsers
+*
+* Usage:
+*   TraceLog log;
+*   parser.setTraceSink(&log);      // nullptr (the default) = no tracing
+*   parser.parse("abba");
+*   for (auto &line : log.render(parser.getGrammar())) { ... }
+*
+* The parsers only record small POD events (kind, rule, positions);
+* turning them into text is done on demand by describeEvent/render.
+* Without a sink a trace point costs one predictable branch, and
+* building with -DPARSER_TRACING=0 removes the trace points entirely.
+**************************************************/
+
+#ifndef PARSETRACE_H
+#define PARSETRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GrammarIndex.h"
+
+#ifndef PARSER_TRACING
+#define PARSER_TRACING 1
+#endif
+
+enum class TraceKind : uint8_t {
+ // Earley
+ EarleyReset,        // rule 0 inserted at chart[0]
+ EarleyScan,         // pos, a = input char, flag = something matched
+ EarleyPredict,      // pos, rule
+ EarleyComplete,     // pos, rule
+ EarleyLeoComplete,  // pos, rule, a = topmost dotted rule, b = its origin
+ EarleyAdvance,      // pos (after the step), a = input char
+ EarleyEnd,          // pos, flag = accepted
+ // GLR
+ GLRShift,           // pos, a = from state, b = to state
+ GLRReduce,          // pos, rule, b = goto state
+ GLRAccept,          // pos
+ GLRReject           // pos
+};
+
+struct TraceEvent {
+ TraceKind kind;
+ uint8_t flag;
+ int32_t rule;
+ uint32_t pos;
+ uint32_t a = 0;
+ uint32_t b = 0;
+};
+
+// Receives the events of a parse
+class TraceSink {
+public:
+ virtual ~TraceSink() = default;
+ virtual void record(const TraceEvent &event) = 0;
+};
+
+// Sink that keeps every event, e.g. for the GUI's step mode
+class TraceLog : public TraceSink {
+public:
+ void record(const TraceEvent &event) override { events.push_back(event); }
+ void clear() { events.clear(); }
+
+ const std::vector<TraceEvent> &getEvents() const { return events; }
+ std::vector<std::string> render(const GrammarIndex &grammar) const;
+
+private:
+ std::vector<TraceEvent> events;
+};
+
+// Human-readable message for one event
+std::string describeEvent(const TraceEvent &event, const GrammarIndex &grammar);
+
+// Trace point used inside the parsers
+#if PARSER_TRACING
+#define PARSER_TRACE(sink, ...) \
+ do { if (sink) (sink)->record(TraceEvent{__VA_ARGS__}); } while (0)
+#else
+// unevaluated, only keeps the arguments "used"
+#define PARSER_TRACE(sink, ...) do { (void)sizeof(TraceEvent{__VA_ARGS__}); } while (0)
+#endif
+
+#endif // PARSETRACE_H
@@ -0,0 +1,108 @@
+#include "ThreadPool.h"
+
+// The pool and worker index of the calling thread (null outside pools)
+static thread_local const ThreadPool *workerPool = nullptr;
+static thread_local size_t workerIndex = 0;
+
+/**************************************************
+ * Lifetime
+ **************************************************/
+
+ThreadPool::ThreadPool(size_t threads) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+  }
+  for (size_t i = 0; i < threads; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> guard(sleepLock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker : workers) worker.join();
+}
+
+size_t ThreadPool::currentWorker() const {
+  return workerPool == this ? workerIndex : workers.size();
+}
+
+/**************************************************
+ * Scheduling
+ **************************************************/
+
+void ThreadPool::submit(Task task) {
+  pending.fetch_add(1);
+  size_t self = currentWorker();
+  size_t target = self < queues.size() ? self : nextQueue.fetch_add(1) % queues.size();
+  {
+    std::lock_guard<std::mutex> guard(queues[target]->lock);
+    queues[target]->tasks.push_back(std::move(task));
+  }
+  {
+    // Counted under the sleep lock, so a worker about to sleep sees it
+    std::lock_guard<std::mutex> guard(sleepLock);
+    queued.fetch_add(1);
+  }
+  wake.notify_one();
+}
+
+bool ThreadPool::runOne(size_t index) {
+  Task task;
+  size_t n = queues.size();
+  // Own deque from the back (most recent, still in cache) ...
+  if (index < n) {
+    Queue &own = *queues[index];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+    }
+  }
+  // ... otherwise steal the oldest task of another worker
+  for (size_t k = 1; !task && k <= n; k++) {
+    Queue &victim = *queues[(index + k) % n];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+    }
+  }
+  if (!task) return false;
+
+  queued.fetch_sub(1);
+  task(index);
+  if (pending.fetch_sub(1) == 1) {
+    std::lock_guard<std::mutex> guard(sleepLock);
+    idle.notify_all();
+  }
+  return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+  workerPool = this;
+  workerIndex = index;
+  for (;;) {
+    if (runOne(index)) continue;
+    std::unique_lock<std::mutex> guard(sleepLock);
+    wake.wait(guard, [this] { return stopping || queued.load() > 0; });
+    if (stopping && queued.load() == 0) return;
+  }
+}
+
+void ThreadPool::wait() {
+  size_t self = currentWorker();
+  while (pending.load() != 0) {
+    if (runOne(self)) continue;
+    std::unique_lock<std::mutex> guard(sleepLock);
+    idle.wait(guard, [this] { return pending.load() == 0 || queued.load() > 0; });
+  }
+}
@@ -0,0 +1,104 @@
+/**************************************************
+* ThreadPool.h - Small work-stealing thread pool
+*
+* Usage:
+*   ThreadPool pool;                      // one worker per core
+*   pool.parallelFor(n, [&](size_t i, size_t worker) { ... });
+*
+*   pool.submit([&](size_t worker) { ... });
+*   pool.wait();
+*
+* Every worker owns a task deque: it pops its own tasks from the
+* back and steals from the front of the others when it runs dry.
+* Tasks get the index of the worker running them, in [0, size()];
+* size() is used for threads outside the pool that help out while
+* waiting, so per-worker scratch needs size() + 1 slots.
+**************************************************/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+ using Task = std::function<void(size_t worker)>;
+
+ // threads = 0 uses std::thread::hardware_concurrency()
+ explicit ThreadPool(size_t threads = 0);
+ ~ThreadPool();
+ ThreadPool(const ThreadPool &) = delete;
+ ThreadPool &operator=(const ThreadPool &) = delete;
+
+ size_t size() const { return workers.size(); }
+
+ // Queues a task; from inside a task it goes to the caller's own deque
+ void submit(Task task);
+ // Blocks until every submitted task has finished, running tasks
+ // meanwhile. Not from inside a task (it would wait for itself).
+ void wait();
+
+ // Calls f(i, worker) for every i in [0, count) and returns when all
+ // calls are done. Indices are handed out in chunks of `grain`. Safe to
+ // call from inside a task: the caller runs tasks while it waits.
+ template <typename F>
+ void parallelFor(size_t count, F &&f, size_t grain = 1);
+
+private:
+ struct Queue {
+   std::mutex lock;
+   std::deque<Task> tasks;
+ };
+ std::vector<std::unique_ptr<Queue>> queues; // one per worker
+ std::vector<std::thread> workers;
+
+ std::mutex sleepLock;
+ std::condition_variable wake;  // workers: tasks were queued or stopping
+ std::condition_variable idle;  // wait(): pending dropped to zero
+ std::atomic<size_t> queued{0};  // tasks sitting in a deque
+ std::atomic<size_t> pending{0}; // tasks submitted and not finished
+ std::atomic<size_t> nextQueue{0};
+ bool stopping = false;
+
+ void workerLoop(size_t index);
+ // Pops a task (own deque first, then steals) and runs it
+ bool runOne(size_t index);
+ size_t currentWorker() const;
+};
+
+template <typename F>
+void ThreadPool::parallelFor(size_t count, F &&f, size_t grain) {
+  if (count == 0) return;
+  if (grain == 0) grain = 1;
+  size_t chunks = (count + grain - 1) / grain;
+  if (chunks == 1 || workers.empty()) {
+    size_t self = currentWorker();
+    for (size_t i = 0; i < count; i++) f(i, self);
+    return;
+  }
+
+  std::atomic<size_t> remaining{chunks};
+  for (size_t c = 0; c < chunks; c++) {
+    size_t first = c * grain;
+    size_t last = first + grain < count ? first + grain : count;
+    submit([&f, &remaining, first, last](size_t worker) {
+      for (size_t i = first; i < last; i++) f(i, worker);
+      remaining.fetch_sub(1, std::memory_order_release);
+    });
+  }
+  // Help until our chunks are done; other tasks may run here too
+  size_t self = currentWorker();
+  while (remaining.load(std::memory_order_acquire) != 0) {
+    if (!runOne(self)) std::this_thread::yield();
+  }
+}
+
+#endif // THREADPOOL_H
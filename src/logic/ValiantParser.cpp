@@ -0,0 +1,125 @@
+#include "ValiantParser.h"
+#include "CYKParser.h"
+#include <map>
+
+/**************************************************
+ * Construction
+ **************************************************/
+
+ValiantParser::ValiantParser(const CFG &cfg) : grammar(cfg) {
+  CNFRules rules = splitCNFRules(grammar);
+  acceptsEmpty = rules.acceptsEmpty;
+
+  uint32_t slots = 0;
+  slotOf.assign(grammar.nonTerminalCount(), -1);
+  auto slot = [&](SymbolId nt) {
+    int32_t &s = slotOf[grammar.nonTerminalIndex(nt)];
+    if (s < 0) s = (int32_t)slots++;
+    return (uint32_t)s;
+  };
+
+  terminalHeads.assign(grammar.terminalCount(), {});
+  for (const auto &rule : rules.terminalRules) {
+    terminalHeads[rule.second].push_back(slot(rule.first));
+  }
+  // One product per distinct (B, C), shared by all its heads
+  std::map<std::pair<uint32_t, uint32_t>, size_t> pairIndex;
+  for (const auto &rule : rules.binaryRules) {
+    std::pair<uint32_t, uint32_t> key(slot(rule.left), slot(rule.right));
+    auto it = pairIndex.emplace(key, pairs.size()).first;
+    if (it->second == pairs.size()) {
+      pairs.push_back(key);
+      pairHeads.emplace_back();
+    }
+    pairHeads[it->second].push_back(slot(rule.head));
+  }
+  T.resize(slots);
+  P.resize(pairs.size());
+}
+
+/**************************************************
+ * Parsing
+ **************************************************/
+
+bool ValiantParser::parse(const std::string &input) {
+  length = input.size();
+  currentInput.clear();
+  for (char c : input) currentInput.push_back(grammar.terminalFor(c));
+  if (length == 0) {
+    accepted = acceptsEmpty;
+    return accepted;
+  }
+
+  // Positions 0..length, padded to a power of two; the padding spans
+  // contain no symbols and stay empty.
+  size_t size = 2;
+  while (size < length + 1) size *= 2;
+  for (auto &m : T) m.resize(size);
+  for (auto &m : P) m.resize(size);
+
+  compute(0, size);
+  accepted = derives(grammar.startSymbol(), 0, length);
+  return accepted;
+}
+
+// All spans [i, j) with l <= i < j < m
+void ValiantParser::compute(size_t l, size_t m) {
+  if (m - l < 2) return;
+  size_t mid = (l + m) / 2;
+  compute(l, mid);
+  compute(mid, m);
+  complete(l, mid, mid - l);
+}
+
+// The block of spans [i, j) with i in B = [l, l+s) and j in C = [l2, l2+s),
+// l + s <= l2. Expects the spans inside B and inside C to be known, and
+// P to hold the split points between the blocks, [l+s, l2).
+void ValiantParser::complete(size_t l, size_t l2, size_t s) {
+  if (s == 1) {
+    fillCell(l, l2);
+    return;
+  }
+  size_t h = s / 2;
+  size_t b1 = l, b2 = l + h, c1 = l2, c2 = l2 + h;
+  // The quarter next to the diagonal has all its outer split points
+  complete(b2, c1, h);
+  // The others get the split points in the quarters between them first
+  addProducts(b1, b2, c1, h);
+  complete(b1, c1, h);
+  addProducts(b2, c1, c2, h);
+  complete(b2, c2, h);
+  addProducts(b1, b2, c2, h);
+  addProducts(b1, c1, c2, h);
+  complete(b1, c2, h);
+}
+
+// P[X, Y] |= T[X, Z] x T[Z, Y] for every pair, X, Z, Y of size s
+void ValiantParser::addProducts(size_t x, size_t z, size_t y, size_t s) {
+  for (size_t p = 0; p < pairs.size(); p++) {
+    orMultiply(P[p], T[pairs[p].first], T[pairs[p].second], x, z, y, s);
+  }
+}
+
+void ValiantParser::fillCell(size_t i, size_t j) {
+  if (j == i + 1) {
+    // A -> a; positions past the input have no symbol
+    if (i < length && currentInput[i] != NoSymbol) {
+      for (uint32_t head : terminalHeads[currentInput[i]]) T[head].set(i, j);
+    }
+    return;
+  }
+  for (size_t p = 0; p < pairs.size(); p++) {
+    if (!P[p].get(i, j)) continue;
+    for (uint32_t head : pairHeads[p]) T[head].set(i, j);
+  }
+}
+
+/**************************************************
+ * Table queries
+ **************************************************/
+
+bool ValiantParser::derives(SymbolId nt, size_t start, size_t len) const {
+  if (len == 0 || start + len > length || !grammar.isNonTerminal(nt)) return false;
+  int32_t slot = slotOf[grammar.nonTerminalIndex(nt)];
+  return slot >= 0 && T[slot].get(start, start + len);
+}
@@ -0,0 +1,74 @@
+/**************************************************
+* ValiantParser.h - Subcubic CYK by Boolean matrix multiplication
+*
+* Usage:
+*   CFG cfg("grammar.json");
+*   cfg.toCNF();
+*   ValiantParser parser(cfg);
+*   bool ok = parser.parse(longInput);
+*
+* Recognizes the same language as CYKParser (the grammar must be in
+* Chomsky normal form), but fills the table the way Valiant's
+* algorithm does, in Okhotin's formulation ("Parsing by matrix
+* multiplication generalized to Boolean grammars", 2014): the table
+* is split recursively into blocks, and everything a block needs from
+* the blocks below and left of it is added with Boolean matrix
+* products, one per pair (B, C) of a rule A -> BC.
+*
+* The products run on packed bit matrices with the Four Russians
+* method (BitMatrix.h), which saves a log factor over the cell-by-cell
+* fill on long, dense (highly ambiguous) inputs. Memory is one n x n
+* bit matrix per nonterminal and per right-hand side pair.
+**************************************************/
+
+#ifndef VALIANTPARSER_H
+#define VALIANTPARSER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "CFG.h"
+#include "GrammarIndex.h"
+#include "BitMatrix.h"
+
+class ValiantParser {
+public:
+ explicit ValiantParser(const CFG &cfg);
+
+ // Fills the table for `input`, true if the start symbol derives it
+ bool parse(const std::string &input);
+ bool isAccepted() const { return accepted; }
+
+ // Whether nt derives input[start, start + len) in the last parse
+ size_t inputLength() const { return length; }
+ bool derives(SymbolId nt, size_t start, size_t len) const;
+
+ const GrammarIndex &getGrammar() const { return grammar; }
+
+private:
+ GrammarIndex grammar;
+ bool acceptsEmpty = false;
+
+ // Matrices are kept for the nonterminals used by some rule only
+ std::vector<int32_t> slotOf;                           // nonterminal index -> slot, -1 if unused
+ std::vector<std::vector<uint32_t>> terminalHeads;      // terminal id -> slots A with A -> a
+ std::vector<std::pair<uint32_t, uint32_t>> pairs;      // slots (B, C) of the rules A -> BC
+ std::vector<std::vector<uint32_t>> pairHeads;          // per pair: slots of the heads A
+
+ // T[slot](i, j): the nonterminal derives input[i, j).
+ // P[pair](i, j): input[i, j) splits into B C for some split point
+ // added so far.
+ std::vector<BitMatrix> T;
+ std::vector<BitMatrix> P;
+ std::vector<SymbolId> currentInput;
+ size_t length = 0;
+ bool accepted = false;
+
+ void compute(size_t l, size_t m);
+ void complete(size_t l, size_t l2, size_t s);
+ void addProducts(size_t x, size_t z, size_t y, size_t s);
+ void fillCell(size_t i, size_t j);
+};
+
+#endif // VALIANTPARSER_H
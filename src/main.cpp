@@ -1,61 +1,33 @@
-#include <GL/glew.h>
-#include <GLFW/glfw3.h>
-#include "imgui.h"
-#include "imgui_impl_glfw.h"
-#include "imgui_impl_opengl3.h"
+// Headless command line tool, links only cfgcore.
+//
+// Usage: Release <grammar.json> <string>...
+// reports for every string whether the grammar is ambiguous on it.
+//
+// Usage: Release --batch <grammar.json> [options]
+// parses every input of stdin in parallel, one JSON line per input
+// (see BatchRunner.h), and a summary on stderr. Options:
+//   --input FILE         read the inputs from FILE instead of stdin
+//   --length-prefixed    inputs are "<length>\n<bytes>" records, not lines
+//   --engine earley|glr  parser to use (earley)
+//   --threads N          pool size (one per core)
+//   --block N            inputs per block (4096)
+//   --cache DIR          keep the compiled LR tables in DIR (GrammarCache.h)
+//
+// Usage: Release --convert <grammar.json> <grammar.cfgb>
+// writes the grammar in the binary format of BinaryGrammar.h. Every
+// mode accepts a .cfgb file wherever it takes a grammar; --batch maps
+// it and compiles it directly.
+//
+// Without arguments it runs the ambiguity checks on the example grammars.
+
 #include <iostream>
 #include <fstream>
 #include <string>
 #include "logic/GLRParser.h"
 #include "logic/EarleyParser.h"
-#include "../stb/stb_image.h"
-
-// Function to generate a Graphviz DOT file and render it to a PNG
-bool generateGraphImage(const std::string& dotFilename, const std::string& outputImage) {
-    // Write a simple DOT file
-    std::ofstream dotFile(dotFilename);
-    if (!dotFile) {
-        std::cerr << "Failed to create DOT file!" << std::endl;
-        return false;
-    }
-    dotFile << "digraph G {\n"
-            << "  A -> B;\n"
-            << "  B -> C;\n"
-            << "  C -> A;\n"
-            << "}\n";
-    dotFile.close();
-
-    // Use Graphviz to render the DOT file into a PNG
-    std::string command = "dot -Tpng " + dotFilename + " -o " + outputImage;
-    int result = std::system(command.c_str());
-    if (result != 0) {
-        std::cerr << "Graphviz rendering failed!" << std::endl;
-        return false;
-    }
-    return true;
-}
-
-// OpenGL utility: Load a texture from a PNG file
-GLuint loadTexture(const std::string& imagePath) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Load image data
-    int width, height, channels;
-    unsigned char* data = stbi_load(imagePath.c_str(), &width, &height, &channels, 4);
-    if (!data) {
-        std::cerr << "Failed to load image: " << imagePath << std::endl;
-        return 0;
-    }
-
-    // Generate texture
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(data);
-    return textureID;
-}
+#include "logic/BatchRunner.h"
+#include "logic/GrammarCache.h"
+#include "logic/BinaryGrammar.h"
 
 /*
 int main() {
@@ -69,7 +41,131 @@ int main() {
 // ambigu test
 
 
-int main() {
+static void batchUsage(const char *program) {
+  std::cerr << "usage: " << program << " --batch <grammar.json|.cfgb> [--input FILE] [--length-prefixed]"
+            << " [--engine earley|glr] [--threads N] [--block N] [--cache DIR]" << std::endl;
+}
+
+// A whole non-negative decimal number, false for "", "abc", "-1", "4k"
+static bool parseCount(const std::string &text, size_t &out) {
+  if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+  try {
+    out = std::stoul(text);
+  } catch (const std::out_of_range &) {
+    return false;
+  }
+  return true;
+}
+
+static int runBatch(int argc, char **argv) {
+  if (argc < 3) {
+    batchUsage(argv[0]);
+    return 2;
+  }
+  std::string inputFile, cacheDir;
+  InputFraming framing = InputFraming::Lines;
+  ParseEngine engine = ParseEngine::Earley;
+  size_t threads = 0, block = 4096;
+  for (int i = 3; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--length-prefixed") {
+      framing = InputFraming::LengthPrefixed;
+    } else if (arg == "--input" && hasValue) {
+      inputFile = argv[++i];
+    } else if (arg == "--engine" && hasValue) {
+      std::string name = argv[++i];
+      if (name != "earley" && name != "glr") {
+        std::cerr << "unknown engine " << name << std::endl;
+        return 2;
+      }
+      engine = name == "glr" ? ParseEngine::GLR : ParseEngine::Earley;
+    } else if ((arg == "--threads" || arg == "--block") && hasValue) {
+      size_t &value = arg == "--threads" ? threads : block;
+      if (!parseCount(argv[++i], value) || (arg == "--block" && value == 0)) {
+        std::cerr << "invalid value for " << arg << ": " << argv[i] << std::endl;
+        batchUsage(argv[0]);
+        return 2;
+      }
+    } else if (arg == "--cache" && hasValue) {
+      cacheDir = argv[++i];
+    } else {
+      std::cerr << "unknown option " << arg << std::endl;
+      return 2;
+    }
+  }
+
+  try {
+    std::ifstream file;
+    if (!inputFile.empty()) {
+      file.open(inputFile, std::ios::binary);
+      if (!file) throw std::runtime_error("Unable to open file " + inputFile);
+    }
+    std::istream &in = inputFile.empty() ? std::cin : file;
+
+    std::ios::sync_with_stdio(false);
+    ThreadPool pool(threads);
+    std::unique_ptr<GrammarCache> cache;
+    if (!cacheDir.empty() && engine == ParseEngine::GLR) cache.reset(new GrammarCache(cacheDir));
+    std::shared_ptr<const CompiledGrammar> compiled;
+    if (BinaryGrammar::isBinaryGrammarFile(argv[2])) {
+      // Compiled straight from the mapped file, no CFG in between
+      std::shared_ptr<const BinaryGrammar> binary = BinaryGrammar::open(argv[2]);
+      compiled = cache ? cache->load(*binary) : CompiledGrammar::compile(*binary);
+    } else {
+      CFG cfg(argv[2]);
+      compiled = cache ? cache->load(cfg) : CompiledGrammar::compile(cfg);
+    }
+    BatchRunner runner(compiled, engine, pool);
+    runner.setBlockSize(block);
+    BatchSummary summary = runner.run(in, framing, std::cout);
+    std::cerr << summary.inputs << " inputs, " << summary.accepted << " accepted, "
+              << summary.errors << " errors in " << summary.seconds << " s" << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+static int runConvert(int argc, char **argv) {
+  if (argc != 4) {
+    std::cerr << "usage: " << argv[0] << " --convert <grammar.json> <grammar.cfgb>" << std::endl;
+    return 2;
+  }
+  try {
+    BinaryGrammar::write(CFG(argv[2]), argv[3]);
+    std::shared_ptr<const BinaryGrammar> written = BinaryGrammar::open(argv[3]);
+    std::cerr << argv[3] << ": " << written->symbolCount() << " symbols, "
+              << written->productionCount() << " productions" << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::string(argv[1]) == "--batch") {
+    return runBatch(argc, argv);
+  }
+  if (argc > 1 && std::string(argv[1]) == "--convert") {
+    return runConvert(argc, argv);
+  }
+  if (argc > 1) {
+    try {
+      CFG cfg(argv[1]);
+      for (int i = 2; i < argc; i++) {
+        AmbiguityReport report = cfg.checkAmbiguity(argv[i]);
+        std::cout << argv[i] << ": " << report.verdictName() << " parse tree(s)" << std::endl;
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
   // Test the trivial unambiguous CFG
   CFG cfg_unambiguous("../src/JSON/input-unambiguous.json");
   std::string testString1 = "a";
@@ -80,9 +176,9 @@ int main() {
     std::cout << "The CFG is not ambiguous for the string \"" << testString1 << "\"" << std::endl;
   }
 
-  // Test the first ambiguous CFG (no epsilon)
+  // Test the first ambiguous CFG (no epsilon): "aaa" is a|aa or aa|a
   CFG cfg_ambiguous("../src/JSON/input-ambiguous.json");
-  std::string testString2 = "aa";
+  std::string testString2 = "aaa";
   std::cout << "\nTesting ambiguity for the first ambiguous grammar with string: " << testString2 << std::endl;
   if (cfg_ambiguous.isAmbiguous(testString2)) {
     std::cout << "The CFG is ambiguous for the string \"" << testString2 << "\"" << std::endl;
@@ -90,9 +186,9 @@ int main() {
     std::cout << "The CFG is not ambiguous for the string \"" << testString2 << "\"" << std::endl;
   }
 
-  // Test the second ambiguous CFG (with epsilon)
+  // Test the second ambiguous CFG (with epsilon): "a" is a|ε or ε|a
   CFG cfg_ambiguous2("../src/JSON/input-ambiguous-2.json");
-  std::string testString3 = "aa";
+  std::string testString3 = "a";
   std::cout << "\nTesting ambiguity for the second ambiguous grammar with string: " << testString3 << std::endl;
   if (cfg_ambiguous2.isAmbiguous(testString3)) {
     std::cout << "The CFG is ambiguous for the string \"" << testString3 << "\"" << std::endl;
@@ -11,6 +11,7 @@
 #include "logic/CFG.h"
 #include "logic/EarleyParser.h"
 #include "logic/GLRParser.h"
+#include "logic/GrammarCache.h"
 
 // ImGui and backend
 #include "imgui.h"
@@ -74,7 +75,9 @@ static void generateDotFileForGrammar(const CFG &cfg, const std::string &filenam
   for (auto &rule : cfg.getProductionRules()) {
     for (auto &body : rule.second) {
       // Represent body as a single string
-      out << "  \"" << rule.first << "\" -> \"" << body << "\";\n";
+      std::string label;
+      for (const auto &sym : body) label += sym;
+      out << "  \"" << rule.first << "\" -> \"" << label << "\";\n";
     }
   }
   out << "}\n";
@@ -84,6 +87,7 @@ static void generateDotFileForGrammar(const CFG &cfg, const std::string &filenam
 // For Earley
 static void generateDotFileForParserState(const EarleyParser &parser, const std::string &filename) {
   const auto &chart = parser.getChart();
+  const GrammarIndex &grammar = parser.getGrammar();
   std::ofstream out(filename);
   if (!out) {
     std::cerr << "Cannot open " << filename << " for writing Earley.\n";
@@ -107,20 +111,19 @@ static void generateDotFileForParserState(const EarleyParser &parser, const std:
 
     int itemIndex = 0;
     for (const auto &item : chart[i]) {
-      if (item.head == "S'") continue; // skip augmented
+      int ruleId = grammar.dottedRuleOf(item.dottedRule);
+      size_t dotPos = grammar.dottedDotOf(item.dottedRule);
+      if (ruleId == 0) continue; // skip augmented
 
       // Node
       std::string nodeName = "Item_" + std::to_string(i) + "_" + std::to_string(itemIndex);
 
-      std::string dotBody = item.body;
-      if (item.dotPos <= dotBody.size()) {
-        dotBody.insert(item.dotPos, "•");
-      }
-      std::string itemLabel = item.head + " -> " + dotBody + " (start=" + std::to_string(item.startIdx) + ")";
+      std::string itemLabel = grammar.ruleToString(ruleId, (int)dotPos)
+                              + " (start=" + std::to_string(item.origin) + ")";
 
       std::string fillColor = "white";
-      if (item.dotPos == 0) fillColor = "red";
-      else if (item.dotPos < item.body.size()) fillColor = "yellow";
+      if (dotPos == 0) fillColor = "red";
+      else if (dotPos < grammar.ruleLength(ruleId)) fillColor = "yellow";
       else fillColor = "green";
 
       out << "    " << nodeName
@@ -219,6 +222,8 @@ static char editorStartSymbol[16] = "";
 
 static bool importMenuOpen = false;
 static std::string grammarsDir = "../grammars/";
+// Compiled LR tables of loaded grammars, so reloading one is instant
+static GrammarCache grammarCache(grammarsDir + ".cfgc/");
 static std::vector<std::string> availableGrammars;
 
 static bool exportMenuOpen = false;
@@ -229,10 +234,31 @@ static std::unique_ptr<CFG> currentCFG;
 static std::unique_ptr<EarleyParser> earleyParser;
 static std::unique_ptr<GLRParser> glrParser;
 
+// Step mode records trace events; they are only turned into text here
+static TraceLog earleyTrace;
+static TraceLog glrTrace;
+static std::vector<std::string> earleyStepLog;
+static std::vector<std::string> glrStepLog;
+
 static bool showLegendWindow = false;
 
 static int exportChoice = 0; // 0=Grammar, 1=Earley, 2=GLR
 
+//////////////////////////////////////////////////////////////////////////////////////
+// Step log: renders the events recorded since the last call
+//////////////////////////////////////////////////////////////////////////////////////
+static void appendStepLog(const TraceLog &trace, const GrammarIndex &grammar, std::vector<std::string> &log) {
+  const auto &events = trace.getEvents();
+  for (size_t i = log.size(); i < events.size(); i++) {
+    log.push_back(describeEvent(events[i], grammar));
+  }
+}
+
+static void startStepLog(TraceLog &trace, std::vector<std::string> &log) {
+  trace.clear();
+  log.clear();
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 // Refresh listing
 //////////////////////////////////////////////////////////////////////////////////////
@@ -484,9 +510,9 @@ int main(int, char**)
                   if (!firstOuter) out << ",\n";
                   out << "    {\"head\": \"" << rule.first << "\", \"body\": [";
                   bool firstInner = true;
-                  for (char c : body) {
+                  for (const auto &sym : body) {
                     if (!firstInner) out << ", ";
-                    out << "\"" << c << "\"";
+                    out << "\"" << sym << "\"";
                     firstInner = false;
                   }
                   out << "]}";
@@ -677,8 +703,9 @@ int main(int, char**)
         saveEditorCFGToJSON(savePath);
         try {
           currentCFG = std::make_unique<CFG>(savePath);
-          earleyParser = std::make_unique<EarleyParser>(*currentCFG);
-          glrParser = std::make_unique<GLRParser>(*currentCFG);
+          auto compiled = grammarCache.load(*currentCFG);
+          earleyParser = std::make_unique<EarleyParser>(compiled);
+          glrParser = std::make_unique<GLRParser>(compiled);
           updateGraphVisualization();
           refreshAvailableGrammars();
         }catch(...){}
@@ -692,8 +719,9 @@ int main(int, char**)
     if(ImGui::Button("Load Grammar")) {
       try {
         currentCFG = std::make_unique<CFG>(grammarPath);
-        earleyParser = std::make_unique<EarleyParser>(*currentCFG);
-        glrParser = std::make_unique<GLRParser>(*currentCFG);
+        auto compiled = grammarCache.load(*currentCFG);
+        earleyParser = std::make_unique<EarleyParser>(compiled);
+        glrParser = std::make_unique<GLRParser>(compiled);
         parseResultEarley = "Grammar Loaded!";
         parseResultGLR = "Grammar Loaded!";
         stepByStepEarley=false;
@@ -714,6 +742,7 @@ int main(int, char**)
     // Earley
     if(ImGui::Button("Earley Parse (Full)")) {
       if(earleyParser) {
+        earleyParser->setTraceSink(nullptr);
         bool res = earleyParser->parse(inputString);
         parseResultEarley = res?"Accepted":"Rejected";
         updateGraphVisualization();
@@ -722,7 +751,10 @@ int main(int, char**)
     ImGui::SameLine();
     if(ImGui::Button("Earley Step-by-Step")) {
       if(earleyParser) {
+        startStepLog(earleyTrace, earleyStepLog);
+        earleyParser->setTraceSink(&earleyTrace);
         earleyParser->reset(inputString);
+        appendStepLog(earleyTrace, earleyParser->getGrammar(), earleyStepLog);
         stepByStepEarley=true;
         earleyFinished=false;
         updateGraphVisualization();
@@ -731,6 +763,7 @@ int main(int, char**)
     if(stepByStepEarley && !earleyFinished) {
       if(ImGui::Button("Next Step (Earley)")) {
         bool cont = earleyParser->nextStep();
+        appendStepLog(earleyTrace, earleyParser->getGrammar(), earleyStepLog);
         if(!cont) {
           earleyFinished=true;
           parseResultEarley = earleyParser->isAccepted()?"Accepted":"Rejected";
@@ -744,6 +777,7 @@ int main(int, char**)
     // GLR
     if(ImGui::Button("GLR Parse (Full)")) {
       if(glrParser) {
+        glrParser->setTraceSink(nullptr);
         glrParser->reset(inputString);
         while(!glrParser->isDone()) {
           glrParser->nextStep();
@@ -755,7 +789,10 @@ int main(int, char**)
     ImGui::SameLine();
     if(ImGui::Button("GLR Step-by-Step")) {
       if(glrParser) {
+        startStepLog(glrTrace, glrStepLog);
+        glrParser->setTraceSink(&glrTrace);
         glrParser->reset(inputString);
+        appendStepLog(glrTrace, glrParser->getGrammar(), glrStepLog);
         stepByStepGLR=true;
         glrFinished=false;
         updateGraphVisualization();
@@ -764,6 +801,7 @@ int main(int, char**)
     if(stepByStepGLR && !glrFinished) {
       if(ImGui::Button("Next Step (GLR)")) {
         bool cont = glrParser->nextStep();
+        appendStepLog(glrTrace, glrParser->getGrammar(), glrStepLog);
         if(!cont){
           glrFinished=true;
           parseResultGLR = glrParser->isAccepted()?"Accepted":"Rejected";
@@ -776,6 +814,17 @@ int main(int, char**)
     ImGui::Text("Earley result: %s", parseResultEarley.c_str());
     ImGui::Text("GLR result:   %s", parseResultGLR.c_str());
 
+    if((stepByStepEarley || stepByStepGLR) && ImGui::CollapsingHeader("Step Log")) {
+      ImGui::BeginChild("StepLog", ImVec2(0, 200), true);
+      if(stepByStepEarley) {
+        for(const auto &line : earleyStepLog) ImGui::TextUnformatted(line.c_str());
+      }
+      if(stepByStepGLR) {
+        for(const auto &line : glrStepLog) ImGui::TextUnformatted(line.c_str());
+      }
+      ImGui::EndChild();
+    }
+
     if(ImGui::Button("Show Graph")) {
       showGraphWindow=true;
     }
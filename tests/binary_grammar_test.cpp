@@ -0,0 +1,169 @@
+// Checks the .cfgb round trip on the bundled grammars.
+//
+// Usage: BinaryGrammarTest <grammar directory>
+//
+// Every *.json grammar in the directory is written with
+// BinaryGrammar::write and reopened: the symbols (names, terminals,
+// declared variables), the productions in order and the start symbol
+// must match the CFG, and so must a CFG read back from the .cfgb file,
+// fingerprint included. The file truncated at several lengths, with a
+// bad magic or with another format version must make open() throw.
+// Exits 1 on the first failure.
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "BinaryGrammar.h"
+#include "CFG.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+bool fail(const std::string &grammar, const std::string &why) {
+  std::cerr << grammar << ": " << why << std::endl;
+  return false;
+}
+
+// The productions in CFG order, as "head -> body symbols"
+std::vector<std::vector<std::string>> productionsOf(const CFG &cfg) {
+  std::vector<std::vector<std::string>> out;
+  for (const auto &rule : cfg.getProductionRules()) {
+    for (const auto &body : rule.second) {
+      out.push_back({rule.first});
+      out.back().insert(out.back().end(), body.begin(), body.end());
+    }
+  }
+  return out;
+}
+
+bool checkRoundTrip(const std::string &name, const CFG &cfg, const BinaryGrammar &binary) {
+  // Symbols: the terminals, then every nonterminal a rule mentions
+  std::set<std::string> terminals, nonTerminals(cfg.getNonTerminals());
+  for (char t : cfg.getTerminals()) terminals.insert(std::string(1, t));
+  for (const auto &production : productionsOf(cfg)) {
+    for (const auto &symbol : production) {
+      if (!terminals.count(symbol)) nonTerminals.insert(symbol);
+    }
+  }
+  nonTerminals.insert(cfg.getStartSymbol());
+  if (binary.terminalCount() != terminals.size() || binary.symbolCount() != terminals.size() + nonTerminals.size()) {
+    return fail(name, "symbol counts differ");
+  }
+  for (uint32_t s = 0; s < binary.symbolCount(); s++) {
+    std::string symbol(binary.symbolName(s));
+    const std::set<std::string> &expected = binary.isTerminal(s) ? terminals : nonTerminals;
+    if (!expected.count(symbol)) return fail(name, "unexpected symbol " + symbol);
+    if (binary.isDeclared(s) != (cfg.getNonTerminals().count(symbol) != 0)) {
+      return fail(name, "symbol " + symbol + " has the wrong Declared flag");
+    }
+  }
+  if (std::string(binary.symbolName(binary.startSymbol())) != cfg.getStartSymbol()) {
+    return fail(name, "start symbol differs");
+  }
+
+  std::vector<std::vector<std::string>> productions = productionsOf(cfg);
+  if (binary.productionCount() != productions.size()) return fail(name, "production counts differ");
+  for (size_t p = 0; p < productions.size(); p++) {
+    std::vector<std::string> got{std::string(binary.symbolName(binary.productionHead(p)))};
+    for (uint32_t s : binary.productionBody(p)) got.emplace_back(binary.symbolName(s));
+    if (got != productions[p]) return fail(name, "production " + std::to_string(p) + " differs");
+  }
+  if (binary.fingerprint() != cfg.fingerprint()) return fail(name, "fingerprint differs");
+  return true;
+}
+
+bool checkReadBack(const std::string &name, const CFG &cfg, const std::string &path) {
+  CFG back(path);
+  if (back.getProductionRules() != cfg.getProductionRules() || back.getNonTerminals() != cfg.getNonTerminals() ||
+      back.getTerminals() != cfg.getTerminals() || back.getStartSymbol() != cfg.getStartSymbol()) {
+    return fail(name, "the CFG read from the .cfgb file differs");
+  }
+  if (back.fingerprint() != cfg.fingerprint()) return fail(name, "the CFG read back has another fingerprint");
+  return true;
+}
+
+// open() on the damaged bytes must throw std::runtime_error
+bool rejects(const std::string &name, const std::string &path, const std::string &bytes, const std::string &what) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), (std::streamsize)bytes.size());
+  try {
+    BinaryGrammar::open(path);
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+  return fail(name, "a file " + what + " was accepted");
+}
+
+bool checkRejects(const std::string &name, const std::string &path) {
+  std::string good;
+  {
+    std::ifstream in(path, std::ios::binary);
+    good.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  for (size_t length : {size_t(0), size_t(3), size_t(4), size_t(63), size_t(64), good.size() / 2, good.size() - 8,
+                        good.size() - 1}) {
+    if (!rejects(name, path, good.substr(0, length), "truncated to " + std::to_string(length) + " bytes")) {
+      return false;
+    }
+  }
+  std::string bytes = good;
+  bytes[0] = 'X';
+  if (!rejects(name, path, bytes, "with a bad magic")) return false;
+  for (uint32_t version : {0u, BinaryGrammar::FormatVersion - 1, BinaryGrammar::FormatVersion + 1}) {
+    bytes = good;
+    std::memcpy(&bytes[4], &version, sizeof(version));
+    if (!rejects(name, path, bytes, "of version " + std::to_string(version))) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <grammar directory>" << std::endl;
+    return 2;
+  }
+  std::vector<fs::path> grammars;
+  for (const auto &entry : fs::directory_iterator(argv[1])) {
+    if (entry.path().extension() == ".json") grammars.push_back(entry.path());
+  }
+  std::sort(grammars.begin(), grammars.end());
+  if (grammars.empty()) {
+    std::cerr << "No grammars in " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::string path = (fs::temp_directory_path() /
+                      ("cfg-binary-" + std::to_string(std::random_device()()) + ".cfgb")).string();
+  for (const auto &grammar : grammars) {
+    std::string name = grammar.filename().string();
+    try {
+      CFG cfg(grammar.string());
+      BinaryGrammar::write(cfg, path);
+      bool ok = checkRoundTrip(name, cfg, *BinaryGrammar::open(path)) && checkReadBack(name, cfg, path);
+      // The mapping above is gone, checkRejects rewrites the file
+      if (!ok || !checkRejects(name, path)) {
+        fs::remove(path);
+        return 1;
+      }
+    } catch (const std::exception &e) {
+      fail(name, e.what());
+      fs::remove(path);
+      return 1;
+    }
+  }
+
+  fs::remove(path);
+  std::cout << grammars.size() << " grammars round-tripped" << std::endl;
+  return 0;
+}
@@ -0,0 +1,252 @@
+// Differential test of the recognizers against a naive reference.
+//
+// Usage: DifferentialTest [grammars] [seed]
+//
+// Generates small random grammars (ε rules, unit cycles, left and right
+// recursion, nonterminal names that are prefixes of each other) and
+// checks every engine on every string over {a, b} up to MaxLength:
+//   - Earley, with and without Leo items
+//   - GLR on LALR(1) and LR(1) tables, with and without the fast path
+//   - CYK (sequential and tiled on a pool) and Valiant on the CNF form
+// The reference is the least fixpoint of "A derives w[i, j)", computed
+// rule by rule over all spans. CNF drops ε, so the CNF engines are not
+// asked about the empty string. Exits 1 on the first mismatch.
+//
+// Before the random ones, the regression grammars below are checked the
+// same way, plus on their own longer inputs.
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CFG.h"
+#include "CYKParser.h"
+#include "EarleyParser.h"
+#include "GLRParser.h"
+#include "GrammarIndex.h"
+#include "ThreadPool.h"
+#include "ValiantParser.h"
+
+namespace {
+
+constexpr size_t MaxLength = 6;
+const std::vector<std::string> NameSet = {"S", "A", "Ab", "B", "S_", "S_2"};
+const std::vector<std::string> TerminalSet = {"a", "b"};
+
+/****
+ * Reference recognizer
+ ****/
+
+// derives[A][i][j]: nonterminal A derives input[i, j)
+bool referenceAccepts(const GrammarIndex &g, const std::string &input) {
+  size_t n = input.size();
+  std::vector<std::vector<std::vector<uint8_t>>> derives(
+      g.symbolCount(), std::vector<std::vector<uint8_t>>(n + 1, std::vector<uint8_t>(n + 1, 0)));
+  auto symbolDerives = [&](SymbolId sym, size_t i, size_t j) {
+    if (g.isTerminal(sym)) return j == i + 1 && g.terminalFor(input[i]) == sym;
+    return derives[sym][i][j] != 0;
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int r = 1; r < (int)g.ruleCount(); r++) {
+      IdRange<SymbolId> body = g.ruleBody(r);
+      for (size_t i = 0; i <= n; i++) {
+        // ends[k]: the first k body symbols derive input[i, k-th end)
+        std::vector<uint8_t> ends(n + 1, 0);
+        ends[i] = 1;
+        for (SymbolId sym : body) {
+          std::vector<uint8_t> next(n + 1, 0);
+          for (size_t m = i; m <= n; m++) {
+            if (!ends[m]) continue;
+            for (size_t j = m; j <= n; j++) {
+              if (symbolDerives(sym, m, j)) next[j] = 1;
+            }
+          }
+          ends.swap(next);
+        }
+        for (size_t j = i; j <= n; j++) {
+          if (ends[j] && !derives[g.ruleHead(r)][i][j]) {
+            derives[g.ruleHead(r)][i][j] = 1;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+  return derives[g.startSymbol()][0][n] != 0;
+}
+
+/****
+ * Regression grammars
+ ****/
+
+struct Regression {
+  std::string name;
+  nlohmann::json grammar;
+  std::vector<std::string> inputs;  // besides allInputs()
+};
+
+// S -> (A B)^20 with A -> a | ε, B -> b | ε: 40 nullable occurrences in
+// one body, which ε-elimination used to expand into every subset
+Regression longNullableBody() {
+  std::vector<std::string> body;
+  for (int i = 0; i < 20; i++) {
+    body.push_back("A");
+    body.push_back("B");
+  }
+  nlohmann::json j;
+  j["Variables"] = {"S", "A", "B"};
+  j["Terminals"] = TerminalSet;
+  j["Start"] = "S";
+  j["Productions"] = {{{"head", "S"}, {"body", body}},
+                      {{"head", "A"}, {"body", {"a"}}},
+                      {{"head", "A"}, {"body", nlohmann::json::array()}},
+                      {{"head", "B"}, {"body", {"b"}}},
+                      {{"head", "B"}, {"body", nlohmann::json::array()}}};
+  std::string ab;
+  for (int i = 0; i < 20; i++) ab += "ab";
+  return {"long nullable body", j, {ab, ab + "a", "b" + ab, std::string(20, 'a') + std::string(20, 'b')}};
+}
+
+/****
+ * Random grammars
+ ****/
+
+std::string randomGrammarFile(std::mt19937 &rng, const std::string &path) {
+  size_t count = 2 + rng() % (NameSet.size() - 1);
+  std::vector<std::string> names(NameSet.begin(), NameSet.begin() + count);
+
+  nlohmann::json productions = nlohmann::json::array();
+  size_t rules = count + rng() % (2 * count + 1);
+  for (size_t r = 0; r < rules; r++) {
+    std::vector<std::string> body;
+    size_t length = rng() % 4 == 0 ? 0 : 1 + rng() % 3;
+    for (size_t i = 0; i < length; i++) {
+      body.push_back(rng() % 3 == 0 ? TerminalSet[rng() % TerminalSet.size()] : names[rng() % count]);
+    }
+    productions.push_back({{"head", names[rng() % count]}, {"body", body}});
+  }
+
+  nlohmann::json j;
+  j["Variables"] = names;
+  j["Terminals"] = TerminalSet;
+  j["Productions"] = productions;
+  j["Start"] = names[0];
+  std::ofstream(path) << j.dump();
+  return j.dump();
+}
+
+// One recognizer under test; CNF engines are not asked about ""
+struct Engine {
+  std::string name;
+  bool cnf;
+  std::function<bool(const std::string &)> parse;
+};
+
+std::vector<std::string> allInputs() {
+  std::vector<std::string> inputs{""};
+  for (size_t from = 0; from < inputs.size(); from++) {
+    if (inputs[from].size() == MaxLength) continue;
+    for (const auto &t : TerminalSet) inputs.push_back(inputs[from] + t);
+  }
+  return inputs;
+}
+
+// Runs every engine on every input against the reference; false (with
+// the grammar printed) on the first mismatch or exception
+bool checkGrammar(const std::string &path, const std::string &source, const std::vector<std::string> &inputs,
+                  ThreadPool &pool, size_t &checks, size_t &accepted) {
+  try {
+    CFG cfg(path);
+    CFG cnf(path);
+    cnf.toCNF();
+    GrammarIndex reference(cfg);
+
+    std::vector<Engine> engines;
+    auto earley = std::make_shared<EarleyParser>(cfg);
+    auto leo = std::make_shared<EarleyParser>(cfg);
+    leo->setLeoItems(true);
+    engines.push_back({"Earley", false, [=](const std::string &s) { return earley->parse(s); }});
+    engines.push_back({"Earley+Leo", false, [=](const std::string &s) { return leo->parse(s); }});
+    for (LRTableKind kind : {LRTableKind::LALR1, LRTableKind::LR1}) {
+      std::string name = kind == LRTableKind::LALR1 ? "GLR/LALR1" : "GLR/LR1";
+      auto fast = std::make_shared<GLRParser>(cfg, kind);
+      auto gss = std::make_shared<GLRParser>(cfg, kind);
+      gss->setFastPath(false);
+      engines.push_back({name, false, [=](const std::string &s) { return fast->parse(s); }});
+      engines.push_back({name + " no fast path", false, [=](const std::string &s) { return gss->parse(s); }});
+    }
+    auto cyk = std::make_shared<CYKParser>(cnf);
+    auto tiled = std::make_shared<CYKParser>(cnf);
+    tiled->setThreadPool(&pool);
+    tiled->setTileSize(2);
+    auto valiant = std::make_shared<ValiantParser>(cnf);
+    engines.push_back({"CYK", true, [=](const std::string &s) { return cyk->parse(s); }});
+    engines.push_back({"CYK tiled", true, [=](const std::string &s) { return tiled->parse(s); }});
+    engines.push_back({"Valiant", true, [=](const std::string &s) { return valiant->parse(s); }});
+
+    for (const auto &input : inputs) {
+      bool expected = referenceAccepts(reference, input);
+      accepted += expected;
+      for (const auto &engine : engines) {
+        if (engine.cnf && input.empty()) continue;
+        bool got = engine.parse(input);
+        checks++;
+        if (got != expected) {
+          std::cerr << engine.name << " " << (got ? "accepts" : "rejects") << " \"" << input
+                    << "\", the reference " << (expected ? "accepts" : "rejects") << " it.\nGrammar: "
+                    << source << std::endl;
+          return false;
+        }
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\nGrammar: " << source << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t grammars = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 300;
+  std::mt19937 rng(argc > 2 ? (unsigned)std::strtoul(argv[2], nullptr, 10) : 12345u);
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("cfg-differential-" + std::to_string(std::random_device()()) + ".json")).string();
+  std::vector<std::string> inputs = allInputs();
+  ThreadPool pool(2);
+  size_t checks = 0, accepted = 0;
+
+  for (const Regression &regression : {longNullableBody()}) {
+    std::string source = regression.grammar.dump();
+    std::ofstream(path) << source;
+    std::vector<std::string> all = inputs;
+    all.insert(all.end(), regression.inputs.begin(), regression.inputs.end());
+    if (!checkGrammar(path, source, all, pool, checks, accepted)) {
+      std::cerr << "(regression: " << regression.name << ")" << std::endl;
+      std::filesystem::remove(path);
+      return 1;
+    }
+  }
+
+  for (size_t n = 0; n < grammars; n++) {
+    std::string source = randomGrammarFile(rng, path);
+    if (!checkGrammar(path, source, inputs, pool, checks, accepted)) {
+      std::filesystem::remove(path);
+      return 1;
+    }
+  }
+
+  std::filesystem::remove(path);
+  std::cout << grammars << " grammars, " << inputs.size() << " inputs each (" << accepted << " in the language), "
+            << checks << " checks passed" << std::endl;
+  return 0;
+}
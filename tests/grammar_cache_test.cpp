@@ -0,0 +1,185 @@
+// Checks GrammarCache: round trip, damaged files and fingerprints.
+//
+// Usage: GrammarCacheTest
+//
+// For LALR(1) and LR(1) tables of a small ambiguous grammar with an ε
+// rule:
+//   - the first load is a miss that writes the .cfgc file, a second
+//     cache on the same directory hits and maps ACTION/GOTO tables equal
+//     to a fresh LRTables::build
+//   - the file truncated at several lengths, extended, or with any one
+//     byte flipped must be a miss that rebuilds the same tables and
+//     rewrites the file as it was
+// Changing the grammar must change CFG::fingerprint() and the file
+// name. Exits 1 on the first failure.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CFG.h"
+#include "GrammarCache.h"
+#include "LRTables.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+nlohmann::json expressionGrammar() {
+  nlohmann::json j;
+  j["Variables"] = {"E", "P"};
+  j["Terminals"] = {"a", "+", "*", "(", ")"};
+  j["Start"] = "E";
+  j["Productions"] = {{{"head", "E"}, {"body", {"E", "+", "E"}}},
+                      {{"head", "E"}, {"body", {"E", "*", "E"}}},
+                      {{"head", "E"}, {"body", {"(", "E", ")", "P"}}},
+                      {{"head", "E"}, {"body", {"a"}}},
+                      {{"head", "P"}, {"body", {"*"}}},
+                      {{"head", "P"}, {"body", nlohmann::json::array()}}};
+  return j;
+}
+
+void writeFile(const std::string &path, const std::string &bytes) {
+  // Through a new file, so no mapping of the old one ever sees it change
+  std::string temporary = path + ".new";
+  std::ofstream(temporary, std::ios::binary | std::ios::trunc).write(bytes.data(), (std::streamsize)bytes.size());
+  fs::rename(temporary, path);
+}
+
+std::string readFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+bool sameTables(const LRTables &a, const LRTables &b) {
+  if (a.kind != b.kind || a.stateCount != b.stateCount || a.terminalCount != b.terminalCount ||
+      a.nonTerminalCount != b.nonTerminalCount || a.actionStart.size() != b.actionStart.size() ||
+      a.actions.size() != b.actions.size() || a.gotoTable.size() != b.gotoTable.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.actionStart.size(); i++) {
+    if (a.actionStart[i] != b.actionStart[i]) return false;
+  }
+  for (size_t i = 0; i < a.actions.size(); i++) {
+    const LRAction &x = a.actions[i], &y = b.actions[i];
+    if (x.type != y.type || x.stateOrRule != y.stateOrRule || x.length != y.length) return false;
+  }
+  for (size_t i = 0; i < a.gotoTable.size(); i++) {
+    if (a.gotoTable[i] != b.gotoTable[i]) return false;
+  }
+  return true;
+}
+
+bool fail(const std::string &why) {
+  std::cerr << why << std::endl;
+  return false;
+}
+
+bool checkKind(const CFG &cfg, const std::string &directory, LRTableKind kind, size_t &damaged) {
+  std::string name = kind == LRTableKind::LALR1 ? "LALR(1)" : "LR(1)";
+  LRTables reference = LRTables::build(GrammarIndex(cfg), kind);
+  std::string path = GrammarCache(directory).pathFor(cfg.fingerprint(), kind);
+
+  {
+    GrammarCache cache(directory);
+    cache.load(cfg, kind);
+    if (cache.misses() != 1 || cache.hits() != 0 || !fs::exists(path)) {
+      return fail(name + ": the first load did not write " + path);
+    }
+  }
+  std::string good = readFile(path);
+  {
+    GrammarCache cache(directory);
+    auto compiled = cache.load(cfg, kind);
+    if (cache.hits() != 1) return fail(name + ": the second load missed the cache");
+    if (!sameTables(compiled->lrTables(kind), reference)) return fail(name + ": cached tables differ");
+  }
+
+  // Every damaged file must be rebuilt and rewritten
+  auto rebuilds = [&](const std::string &bytes, const std::string &what) {
+    writeFile(path, bytes);
+    GrammarCache cache(directory);
+    auto compiled = cache.load(cfg, kind);
+    damaged++;
+    if (cache.misses() != 1) return fail(name + ": a file " + what + " was used");
+    if (!sameTables(compiled->lrTables(kind), reference)) return fail(name + ": rebuilt tables differ");
+    if (readFile(path) != good) return fail(name + ": a file " + what + " was not rewritten");
+    return true;
+  };
+  for (size_t length : {size_t(0), size_t(1), size_t(63), size_t(64), size_t(65), good.size() / 2,
+                        good.size() - 8, good.size() - 1}) {
+    if (!rebuilds(good.substr(0, length), "truncated to " + std::to_string(length) + " bytes")) return false;
+  }
+  if (!rebuilds(good + std::string(8, '\0'), "with 8 bytes appended")) return false;
+  std::mt19937 rng(7);
+  for (size_t offset = 0; offset < good.size(); offset++) {
+    std::string bytes = good;
+    bytes[offset] = char(bytes[offset] ^ (1 << (rng() % 8)));
+    if (!rebuilds(bytes, "with byte " + std::to_string(offset) + " flipped")) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  std::string base = (fs::temp_directory_path() / ("cfg-cache-" + std::to_string(std::random_device()()))).string();
+  std::string directory = base + "/cache";
+  fs::create_directories(base);
+  std::string path = base + "/grammar.json";
+  auto cleanUp = [&]() {
+    std::error_code error;
+    fs::remove_all(base, error);
+  };
+
+  nlohmann::json grammar = expressionGrammar();
+  std::ofstream(path) << grammar.dump();
+  CFG cfg(path);
+  size_t damaged = 0;
+  for (LRTableKind kind : {LRTableKind::LALR1, LRTableKind::LR1}) {
+    if (!checkKind(cfg, directory, kind, damaged)) {
+      cleanUp();
+      return 1;
+    }
+  }
+
+  // Each change to the grammar must get its own fingerprint
+  std::vector<nlohmann::json> changed(4, grammar);
+  changed[0]["Productions"].push_back({{"head", "P"}, {"body", {"+"}}});
+  changed[1]["Productions"][3]["body"] = {"("};
+  changed[2]["Productions"].erase(5);
+  changed[3]["Start"] = "P";
+  std::vector<uint64_t> fingerprints{cfg.fingerprint()};
+  for (const auto &j : changed) {
+    std::ofstream(path) << j.dump();
+    uint64_t fingerprint = CFG(path).fingerprint();
+    for (uint64_t other : fingerprints) {
+      if (fingerprint == other) {
+        std::cerr << "same fingerprint after a change: " << j.dump() << std::endl;
+        cleanUp();
+        return 1;
+      }
+    }
+    GrammarCache cache(directory);
+    if (cache.pathFor(fingerprint, LRTableKind::LALR1) == cache.pathFor(cfg.fingerprint(), LRTableKind::LALR1)) {
+      std::cerr << "same cache file after a change: " << j.dump() << std::endl;
+      cleanUp();
+      return 1;
+    }
+    fingerprints.push_back(fingerprint);
+  }
+  std::ofstream(path) << grammar.dump();
+  if (CFG(path).fingerprint() != cfg.fingerprint()) {
+    std::cerr << "the fingerprint changed on rereading the grammar" << std::endl;
+    cleanUp();
+    return 1;
+  }
+
+  cleanUp();
+  std::cout << damaged << " damaged files rebuilt, " << fingerprints.size() << " fingerprints distinct" << std::endl;
+  return 0;
+}
@@ -0,0 +1,182 @@
+// Checks CNFProvenance::toOriginal on random grammars.
+//
+// Usage: ProvenanceTest [grammars] [seed]
+//
+// Generates small random grammars with ε rules, unit cycles and bodies
+// of up to MaxBody symbols, converts them to CNF and parses strings over
+// {a, b} with the converted grammar. Every sampled derivation is mapped
+// back with toOriginal and replayed as a leftmost derivation in the
+// original grammar, which has to end in the same string. A non-empty
+// string the original grammar accepts must have at least one derivation.
+// Exits 1 on the first failure.
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CFG.h"
+#include "CNFConverter.h"
+#include "EarleyParser.h"
+#include "GrammarIndex.h"
+
+namespace {
+
+constexpr size_t MaxLength = 6;
+constexpr size_t MaxBody = 7;
+constexpr size_t Samples = 8;
+const std::vector<std::string> NameSet = {"S", "A", "Ab", "B", "S_", "S_2"};
+const std::vector<std::string> TerminalSet = {"a", "b"};
+
+/****
+ * Leftmost derivations
+ ****/
+
+// Applies the rules to the leftmost nonterminal of the sentential form,
+// starting from the start symbol; "" if a rule does not apply there
+std::string replay(const GrammarIndex &g, const std::vector<int> &derivation, std::string &error) {
+  std::vector<SymbolId> form{g.startSymbol()};
+  size_t next = 0;  // everything before is terminals
+  for (int rule : derivation) {
+    while (next < form.size() && g.isTerminal(form[next])) next++;
+    if (rule < 0 || (size_t)rule >= g.ruleCount()) {
+      error = "rule " + std::to_string(rule) + " does not exist";
+      return "";
+    }
+    if (next == form.size() || form[next] != g.ruleHead(rule)) {
+      error = "rule " + std::to_string(rule) + " does not rewrite the leftmost nonterminal";
+      return "";
+    }
+    IdRange<SymbolId> body = g.ruleBody(rule);
+    form.erase(form.begin() + next);
+    form.insert(form.begin() + next, body.begin(), body.end());
+  }
+  std::string out;
+  for (SymbolId s : form) {
+    if (!g.isTerminal(s)) {
+      error = "nonterminal " + g.symbolName(s) + " is left over";
+      return "";
+    }
+    out += g.terminalChar(s);
+  }
+  return out;
+}
+
+/****
+ * Random grammars
+ ****/
+
+std::string randomGrammarFile(std::mt19937 &rng, const std::string &path) {
+  size_t count = 2 + rng() % (NameSet.size() - 1);
+  std::vector<std::string> names(NameSet.begin(), NameSet.begin() + count);
+
+  nlohmann::json productions = nlohmann::json::array();
+  auto add = [&](const std::string &head, const std::vector<std::string> &body) {
+    productions.push_back({{"head", head}, {"body", body}});
+  };
+  size_t rules = count + rng() % (2 * count + 1);
+  for (size_t r = 0; r < rules; r++) {
+    std::vector<std::string> body;
+    size_t length = rng() % 4 == 0 ? 0 : 1 + rng() % (rng() % 3 == 0 ? MaxBody : 3);
+    for (size_t i = 0; i < length; i++) {
+      body.push_back(rng() % 3 == 0 ? TerminalSet[rng() % TerminalSet.size()] : names[rng() % count]);
+    }
+    add(names[rng() % count], body);
+  }
+  // Half of the grammars get a unit cycle through the start symbol
+  if (rng() % 2) {
+    const std::string &other = names[1 + rng() % (count - 1)];
+    add(names[0], {other});
+    add(other, {names[0]});
+  }
+
+  nlohmann::json j;
+  j["Variables"] = names;
+  j["Terminals"] = TerminalSet;
+  j["Productions"] = productions;
+  j["Start"] = names[0];
+  std::ofstream(path) << j.dump();
+  return j.dump();
+}
+
+std::vector<std::string> allInputs() {
+  std::vector<std::string> inputs{""};
+  for (size_t from = 0; from < inputs.size(); from++) {
+    if (inputs[from].size() == MaxLength) continue;
+    for (const auto &t : TerminalSet) inputs.push_back(inputs[from] + t);
+  }
+  inputs.erase(inputs.begin());  // CNF drops ε
+  return inputs;
+}
+
+// False (with the grammar printed) on the first derivation that does
+// not map back
+bool checkGrammar(const std::string &path, const std::string &source, const std::vector<std::string> &inputs,
+                  size_t &derivations) {
+  auto fail = [&](const std::string &input, const std::string &why) {
+    std::cerr << "\"" << input << "\": " << why << "\nGrammar: " << source << std::endl;
+    return false;
+  };
+  try {
+    CFG cfg(path);
+    CFG cnf(path);
+    cnf.toCNF();
+    GrammarIndex original(cfg);
+    const CNFProvenance *provenance = cnf.getCNFProvenance();
+    if (provenance->originalRuleCount() != original.ruleCount()) {
+      return fail("", "provenance lists " + std::to_string(provenance->originalRuleCount()) +
+                          " original rules, the grammar has " + std::to_string(original.ruleCount()));
+    }
+    EarleyParser reference(cfg);
+    EarleyParser parser(cnf);
+    parser.setBuildForest(true);
+
+    for (const auto &input : inputs) {
+      bool expected = reference.parse(input);
+      if (parser.parse(input) != expected) {
+        return fail(input, expected ? "the CNF grammar rejects it" : "the CNF grammar accepts it");
+      }
+      if (!expected) continue;
+      auto sampled = parser.getForest().sampleDerivations(Samples, parser.getGrammar());
+      if (sampled.empty()) return fail(input, "no derivation in the CNF grammar");
+      for (const auto &derivation : sampled) {
+        std::vector<int> mapped = provenance->toOriginal(derivation);
+        std::string error;
+        std::string derived = replay(original, mapped, error);
+        if (!error.empty()) return fail(input, "mapped derivation: " + error);
+        if (derived != input) return fail(input, "mapped derivation yields \"" + derived + "\"");
+        derivations++;
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\nGrammar: " << source << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t grammars = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 300;
+  std::mt19937 rng(argc > 2 ? (unsigned)std::strtoul(argv[2], nullptr, 10) : 12345u);
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("cfg-provenance-" + std::to_string(std::random_device()()) + ".json")).string();
+  std::vector<std::string> inputs = allInputs();
+  size_t derivations = 0;
+
+  for (size_t n = 0; n < grammars; n++) {
+    std::string source = randomGrammarFile(rng, path);
+    if (!checkGrammar(path, source, inputs, derivations)) {
+      std::filesystem::remove(path);
+      return 1;
+    }
+  }
+
+  std::filesystem::remove(path);
+  std::cout << grammars << " grammars, " << derivations << " derivations mapped back" << std::endl;
+  return 0;
+}
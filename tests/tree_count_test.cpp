@@ -0,0 +1,206 @@
+// Checks ParseForest::countTrees against a brute-force count.
+//
+// Usage: TreeCountTest [grammars] [seed]
+//
+// Generates small random grammars (ε rules, and a unit cycle in half of
+// them) and parses every string over {a, b} up to MaxLength with the
+// Earley forest. The reference counts the parse trees of each height
+// bound h, level by level, with no cycle detection at all. A tree whose
+// height exceeds the number of (symbol, span) pairs K repeats a pair on
+// some path, and such a tree can be pumped; so the count is finite iff
+// the bound 3K + 3 adds no trees over the bound K, and then it is the
+// count at K (a level that changes nothing ends the count early).
+// Infinite counts must be reported as infinite, finite ones exactly;
+// where either side saturates, countTrees only has to report saturation
+// or infinity. Exits 1 on the first mismatch.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CFG.h"
+#include "EarleyParser.h"
+#include "GrammarIndex.h"
+#include "ParseForest.h"
+
+namespace {
+
+constexpr size_t MaxLength = 4;
+constexpr uint64_t Cap = uint64_t(1) << 62;  // reference counts saturate here
+const std::vector<std::string> NameSet = {"S", "A", "Ab", "B", "S_"};
+const std::vector<std::string> TerminalSet = {"a", "b"};
+
+/****
+ * Reference count
+ ****/
+
+uint64_t add(uint64_t a, uint64_t b) { return std::min(Cap, a + b); }
+uint64_t multiply(uint64_t a, uint64_t b) {
+  if (a == 0 || b == 0) return 0;
+  return a > Cap / b ? Cap : a * b;
+}
+
+struct ReferenceCount {
+  uint64_t count;
+  bool saturated;  // reached Cap by the bound K: too many to tell apart
+  bool infinite;
+};
+
+ReferenceCount referenceCount(const GrammarIndex &g, const std::string &input) {
+  size_t n = input.size();
+  size_t symbols = g.symbolCount();
+  auto cell = [&](SymbolId s, size_t i, size_t j) { return ((size_t)s * (n + 1) + i) * (n + 1) + j; };
+
+  // trees[cell(A, i, j)]: trees of height <= h with root A over input[i, j)
+  std::vector<uint64_t> trees(symbols * (n + 1) * (n + 1), 0);
+  auto symbolTrees = [&](const std::vector<uint64_t> &t, SymbolId s, size_t i, size_t j) -> uint64_t {
+    if (g.isTerminal(s)) return j == i + 1 && g.terminalFor(input[i]) == s ? 1 : 0;
+    return t[cell(s, i, j)];
+  };
+  // One more level of height; false once nothing changes (a fixpoint)
+  auto nextLevel = [&]() {
+    std::vector<uint64_t> next(trees.size(), 0);
+    for (int r = 1; r < (int)g.ruleCount(); r++) {
+      IdRange<SymbolId> body = g.ruleBody(r);
+      for (size_t i = 0; i <= n; i++) {
+        // ways[m]: ways for the body read so far to cover input[i, m)
+        std::vector<uint64_t> ways(n + 1, 0);
+        ways[i] = 1;
+        for (SymbolId sym : body) {
+          std::vector<uint64_t> step(n + 1, 0);
+          for (size_t m = i; m <= n; m++) {
+            if (!ways[m]) continue;
+            for (size_t j = m; j <= n; j++) {
+              step[j] = add(step[j], multiply(ways[m], symbolTrees(trees, sym, m, j)));
+            }
+          }
+          ways.swap(step);
+        }
+        for (size_t j = i; j <= n; j++) {
+          uint64_t &c = next[cell(g.ruleHead(r), i, j)];
+          c = add(c, ways[j]);
+        }
+      }
+    }
+    bool changed = next != trees;
+    trees.swap(next);
+    return changed;
+  };
+
+  size_t pairs = (g.nonTerminalCount()) * (n + 1) * (n + 2) / 2;
+  bool changing = true;
+  for (size_t h = 0; h < pairs && changing; h++) changing = nextLevel();
+  uint64_t atPairs = trees[cell(g.startSymbol(), 0, n)];
+  for (size_t h = pairs; h < 3 * pairs + 3 && changing; h++) changing = nextLevel();
+  uint64_t beyond = trees[cell(g.startSymbol(), 0, n)];
+  return {atPairs, atPairs == Cap, atPairs != Cap && beyond != atPairs};
+}
+
+/****
+ * Random grammars
+ ****/
+
+std::string randomGrammarFile(std::mt19937 &rng, const std::string &path) {
+  size_t count = 2 + rng() % (NameSet.size() - 1);
+  std::vector<std::string> names(NameSet.begin(), NameSet.begin() + count);
+
+  nlohmann::json productions = nlohmann::json::array();
+  auto rule = [&](const std::string &head, const std::vector<std::string> &body) {
+    productions.push_back({{"head", head}, {"body", body}});
+  };
+  size_t rules = count + rng() % (count + 1);
+  for (size_t r = 0; r < rules; r++) {
+    std::vector<std::string> body;
+    size_t length = rng() % 4 == 0 ? 0 : 1 + rng() % 3;
+    for (size_t i = 0; i < length; i++) {
+      body.push_back(rng() % 2 == 0 ? TerminalSet[rng() % TerminalSet.size()] : names[rng() % count]);
+    }
+    rule(names[rng() % count], body);
+  }
+  // A unit cycle: S -> X, X -> S, or X -> X
+  if (rng() % 2) {
+    const std::string &other = names[rng() % count];
+    rule(names[0], {other});
+    rule(other, {names[0]});
+  }
+
+  nlohmann::json j;
+  j["Variables"] = names;
+  j["Terminals"] = TerminalSet;
+  j["Productions"] = productions;
+  j["Start"] = names[0];
+  std::ofstream(path) << j.dump();
+  return j.dump();
+}
+
+std::vector<std::string> allInputs() {
+  std::vector<std::string> inputs{""};
+  for (size_t from = 0; from < inputs.size(); from++) {
+    if (inputs[from].size() == MaxLength) continue;
+    for (const auto &t : TerminalSet) inputs.push_back(inputs[from] + t);
+  }
+  return inputs;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t grammars = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 300;
+  std::mt19937 rng(argc > 2 ? (unsigned)std::strtoul(argv[2], nullptr, 10) : 12345u);
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("cfg-trees-" + std::to_string(std::random_device()()) + ".json")).string();
+  std::vector<std::string> inputs = allInputs();
+  size_t checks = 0, ambiguous = 0, infinite = 0;
+
+  for (size_t n = 0; n < grammars; n++) {
+    std::string source = randomGrammarFile(rng, path);
+    try {
+      CFG cfg(path);
+      GrammarIndex grammar(cfg);
+      EarleyParser parser(cfg);
+      parser.setBuildForest(true);
+      for (const auto &input : inputs) {
+        ReferenceCount expected = referenceCount(grammar, input);
+        bool accepted = parser.parse(input);
+        TreeCount got = accepted ? parser.getForest().countTrees() : TreeCount{};
+        checks++;
+        bool same;
+        if (expected.saturated) {
+          same = got.saturated || got.infinite;
+        } else {
+          same = got.infinite == expected.infinite && (expected.infinite || got.saturated || got.count == expected.count);
+        }
+        if (!same || accepted != (expected.count > 0)) {
+          std::cerr << "\"" << input << "\": countTrees says "
+                    << (got.infinite ? "infinite" : std::to_string(got.count) + (got.saturated ? "+" : ""))
+                    << ", the reference "
+                    << (expected.infinite ? "infinite" : std::to_string(expected.count) + (expected.saturated ? "+" : ""))
+                    << ".\nGrammar: " << source << std::endl;
+          std::filesystem::remove(path);
+          return 1;
+        }
+        ambiguous += !expected.infinite && expected.count > 1;
+        infinite += expected.infinite;
+      }
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << "\nGrammar: " << source << std::endl;
+      std::filesystem::remove(path);
+      return 1;
+    }
+  }
+
+  std::filesystem::remove(path);
+  if (grammars >= 100 && infinite == 0) {
+    std::cerr << "no input had infinitely many trees" << std::endl;
+    return 1;
+  }
+  std::cout << grammars << " grammars, " << checks << " counts checked (" << ambiguous << " ambiguous, " << infinite
+            << " infinite)" << std::endl;
+  return 0;
+}